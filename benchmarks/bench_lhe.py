@@ -0,0 +1,86 @@
+"""
+Benchmark quicklhe on synthetic LHE files.
+
+Writes a MadGraph-like LHE file of the requested size, times every phase of a parse with
+lhe_parser.benchmark_lhe() and prints the result as one JSON object, so runs on different
+builds and machines can be compared:
+
+   python3 benchmarks/bench_lhe.py --events 200000 --particles 8 --weights 100 --gzip > result.json
+
+lhe_parser must be importable (build it next to this script, or put it on PYTHONPATH).
+"""
+import argparse
+import gzip
+import json
+import os
+import platform
+import random
+import sys
+import tempfile
+import time
+
+import lhe_parser
+
+
+def write_lhe(path, n_events, n_particles, n_weights, compress, seed=1):
+    rng = random.Random(seed)
+    opener = gzip.open if compress else open
+    with opener(path, "wt") as f:
+        f.write('<LesHouchesEvents version="3.0">\n<header>\n<initrwgt>\n')
+        f.write('<weightgroup name="scale_variation" combine="envelope">\n')
+        for w in range(n_weights):
+            f.write(f'<weight id="{w + 1}"> dyn=-1 muR={1 + w % 3} muF={1 + w // 3 % 3} </weight>\n')
+        f.write("</weightgroup>\n</initrwgt>\n</header>\n")
+        f.write("<init>\n2212 2212 6.500000e+03 6.500000e+03 0 0 247000 247000 -4 1\n")
+        f.write("5.066000e+02 1.300000e+00 5.066000e+02 1\n</init>\n")
+        for _ in range(n_events):
+            lines = [f"{n_particles:2d}      1 +5.0660000e+02 {rng.uniform(50, 500):.8e} 7.54677800e-03 1.18000000e-01"]
+            for p in range(n_particles):
+                px, py, pz = (rng.gauss(0, 100) for _ in range(3))
+                m = 173.0 if p >= 2 else 0.0
+                e = (px * px + py * py + pz * pz + m * m) ** 0.5
+                status = -1 if p < 2 else 1
+                mothers = (0, 0) if p < 2 else (1, 2)
+                lines.append(f"{rng.choice((21, 2, -2, 6, -6, 11)):8d} {status:2d} {mothers[0]:4d} {mothers[1]:4d} "
+                             f"{501 + p:4d} {0:4d} {px:+.10e} {py:+.10e} {pz:+.10e} {e:.10e} {m:.10e} 0.0000e+00 9.0000e+00")
+            f.write("<event>\n" + "\n".join(lines) + "\n<rwgt>\n")
+            for w in range(n_weights):
+                f.write(f"<wgt id='{w + 1}'> {rng.uniform(400, 600):+.7e} </wgt>\n")
+            f.write("</rwgt>\n</event>\n")
+        f.write("</LesHouchesEvents>\n")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument("--events", type=int, default=100000)
+    ap.add_argument("--particles", type=int, default=6, help="particles per event")
+    ap.add_argument("--weights", type=int, default=10, help="weights per event")
+    ap.add_argument("--gzip", action="store_true", help="write the file as .lhe.gz")
+    ap.add_argument("--repeat", type=int, default=3, help="runs per phase, the best is reported")
+    ap.add_argument("--layout", default="rows")
+    ap.add_argument("--keep", metavar="PATH", help="write the synthetic file here and keep it")
+    args = ap.parse_args()
+
+    suffix = ".lhe.gz" if args.gzip else ".lhe"
+    path = args.keep or os.path.join(tempfile.mkdtemp(prefix="quicklhe-bench-"), "synthetic" + suffix)
+    t0 = time.perf_counter()
+    write_lhe(path, args.events, args.particles, args.weights, args.gzip)
+    generated = time.perf_counter() - t0
+    try:
+        result = lhe_parser.benchmark_lhe(path, repeat=args.repeat, layout=args.layout)
+    finally:
+        if not args.keep:
+            os.remove(path)
+            os.rmdir(os.path.dirname(path))
+
+    result["config"] = {"events": args.events, "particles": args.particles, "weights": args.weights,
+                        "gzip": args.gzip, "layout": args.layout, "generate_seconds": generated}
+    result["machine"] = {"platform": platform.platform(), "machine": platform.machine(),
+                         "processor": platform.processor(), "cpus": os.cpu_count(),
+                         "python": platform.python_version()}
+    json.dump(result, sys.stdout, indent=2)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
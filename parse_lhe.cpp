@@ -1,7 +1,9 @@
 /* 
    Build: 
-   c++ -O2 -std=c++17 -shared -fPIC $(python3 -m pybind11 --includes) \
-   -lexpat -o lhe_parser$(python3-config --extension-suffix) parse_lhe.cpp
+   c++ -O2 -std=c++17 -shared -fPIC -pthread $(python3 -m pybind11 --includes) \
+   -lexpat -lz -llzma -o lhe_parser$(python3-config --extension-suffix) parse_lhe.cpp
+
+   optional inputs (-DQUICKLHE_WITH_ZSTD, _CURL, _XROOTD): see README.md
 */
 
 /*
@@ -29,322 +31,5331 @@ Structure of init (gives some vital information about processes, Xsection, etc.)
 
 i_evt : shape {n_events,   2}            cols: [NUP, IDPRUP]
 f_evt : shape {n_events,   4+n_weights}  cols: [XWGTUP, SCALUP, AQEDUP, AQCDUP, wgt_0, wgt_1, ...]
-i_ptc : shape {n_particles, 7}           cols: [evt_idx, IDUP, ISTUP, MOTHUP1, MOTHUP2, ICOLUP1, ICOLUP2]
-f_ptc : shape {n_particles, 7}           cols: [PUP1, PUP2, PUP3, PUP4, PUP5, VTIMUP, SPINUP]
+i_ptc : shape {n_particles, 7}           cols: [evt_idx, IDUP, ISTUP, MOTHUP1, MOTHUP2, ICOLUP1, ICOLUP2]  (int64 with index_dtype="int64")
+f_ptc : shape {n_particles, 7}           cols: [PUP1, PUP2, PUP3, PUP4, PUP5, VTIMUP, SPINUP]  (+ derived=[pt, eta, phi, m])
+
+The other layouts, the options and the other functions are described in README.md
 */
-#include <sstream>
 #include <fstream>
 #include <string>
 #include <stdexcept>
 #include <cstring>
+#include <cstdlib>
 #include <charconv>
 #include <string_view>
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <iterator>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <expat.h>
+#include <zlib.h>
+#include <lzma.h>
+#ifdef QUICKLHE_WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef QUICKLHE_WITH_CURL
+#include <curl/curl.h>
+#endif
+#ifdef QUICKLHE_WITH_XROOTD
+#include <XrdCl/XrdClFile.hh>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
+#include <pybind11/stl.h>
 
 namespace py = pybind11;
 
 // ---------------------------------------------------------------------------
-// Pass 1 – line scan to count events and weights
+// Input – plain files, gzip/xz/zstd decompressed on the fly, a memory mapping, or remote
+// files (http(s)://, root://) read by byte range
 // ---------------------------------------------------------------------------
-static std::tuple<int,int,int> countDimensions(const std::string& filename)
+static constexpr size_t CHUNK = 65536;
+
+// sequential byte stream consumed block by block
+class ByteSource
 {
-    std::ifstream f(filename);
-    if (!f.is_open())
-        throw std::runtime_error("Cannot open file: " + filename);
+public:
+    virtual ~ByteSource() = default;
 
-    int n_events    = 0;
-    int n_weights   = 0;
-    int n_particles = 0;
-    int n_line = 0;
+    // fill buf with up to n bytes, 0 only at the end of the input
+    virtual size_t read(char* buf, size_t n) = 0;
 
-    std::string line;
-    while (std::getline(f, line)) {
-        ++n_line;
-        if (line.find("<event>") != std::string::npos) {
-            ++n_events;
-            std::getline(f, line); ++n_line;
-            std::istringstream iss(line);
-            int n;
-            if (!(iss >> n)) throw std::runtime_error("Failed to parse particle count from event header on line: " + std::to_string(n_line));
-            n_particles += n;
-        }
-            
-        if (line.find("<weight ") != std::string::npos) ++n_weights;
+    // next block of input, valid until the following call; empty at the end
+    virtual std::string_view next()
+    {
+        block_.resize(block_size_);
+        return {block_.data(), read(block_.data(), block_size_)};
     }
 
-    return {n_events, n_weights, n_particles};
-}
+    // chunk_size=: bytes per block of next()
+    void setBlockSize(size_t n) { block_size_ = n; }
 
-// ---------------------------------------------------------------------------
-// Pass 2 – SAX parse with expat to fill the array
-// ---------------------------------------------------------------------------
-static constexpr int NO_CAPTURE   = 0;
-static constexpr int EVENT_HEADER = 1;
-static constexpr int WGT_TAG      = 2;
-static constexpr int REWGT_BLOCK  = 3;
+private:
+    std::vector<char> block_;
+    size_t            block_size_ = CHUNK;
+};
 
-struct ParseState
+// [offset, offset + length) of an uncompressed file
+class FileSource : public ByteSource
 {
-    double*     fevt_arr     = nullptr; 
-    int*        ievt_arr     = nullptr;
-    double*     fptc_arr     = nullptr;
-    int*        iptc_arr     = nullptr;
+public:
+    explicit FileSource(const std::string& filename, size_t offset = 0, size_t length = std::string::npos)
+        : f_(filename, std::ios::binary), left_(length)
+    {
+        if (!f_.is_open())
+            throw std::runtime_error("Cannot open file: " + filename);
+        if (offset) f_.seekg(offset);
+    }
 
-    py::dict    reweight;
-    std::string current_rwgt_group;
-    int         current_rwgt_id;
+    size_t read(char* buf, size_t n) override
+    {
+        f_.read(buf, std::min(n, left_));
+        size_t got = static_cast<size_t>(f_.gcount());
+        left_ -= got;
+        return got;
+    }
 
-    int         n_weights    = 0;
-    int         n_events     = 0;
-    int         n_particles  = 0;
+private:
+    std::ifstream f_;
+    size_t        left_;
+};
 
-    int         cur_event    = 0;        // current row index
-    int         cur_weight   = 0;        // current column index (within event)
-    int         cur_particle = 0;
-    int         capture      = NO_CAPTURE;
+static constexpr int FORMAT_PLAIN = 0;
+static constexpr int FORMAT_GZIP  = 1;
+static constexpr int FORMAT_XZ    = 2;
+static constexpr int FORMAT_ZSTD  = 3;
 
-    std::string charBuf;                 // accumulates character data
+// what is known of an input before it is read (probeInput()): the format, by magic bytes
+// rather than extension, and the size and modification time an index is checked against.
+// A URL is opened once for all three (a HEAD request or an XRootD stat, and one range
+// read), and the result passed on to whatever needs them, the handles opened for reading
+// included
+struct InputInfo
+{
+    int      format = FORMAT_PLAIN;
+    uint64_t size   = 0;
+    int64_t  mtime  = -1;  // seconds since the epoch, local and remote alike; -1 if unknown
 };
 
-// helper to traverse charBuf and extract int/double values with no copy or string convert
-template <typename T>
-bool consume_next(std::string_view& sv, T& value) {
-    // advance past leading whitespace
-    size_t begin = sv.find_first_not_of(" \t\n\r");
-    if (begin == std::string_view::npos) return false; // exit if no non delim token
-    sv.remove_prefix(begin);
+// a file on a server, read by byte range: http(s):// through libcurl, root:// through XRootD
+class RemoteFile
+{
+public:
+    virtual ~RemoteFile() = default;
 
-    // find end of token
-    size_t end = sv.find_first_of(" \t\n\r");
-    std::string_view token = sv.substr(0, end);
+    // up to n bytes from offset on, fewer only at the end of the file
+    virtual size_t readAt(uint64_t offset, char* buf, size_t n) = 0;
 
-    // fails on a leading '+' for floating point values
-    if constexpr (std::is_floating_point_v<T>) {
-        if (!token.empty() && token[0] == '+')
-            token.remove_prefix(1);
-    }
+    uint64_t size() const  { return size_; }
+    int64_t  mtime() const { return mtime_; }  // seconds since the epoch, -1 if unknown
 
-    // use from_chars to convert to int/double
-    auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
-    
-    // update string_view to point after this token
-    if (end == std::string_view::npos) sv = {};
-    else sv.remove_prefix(end);
+protected:
+    uint64_t size_  = 0;
+    int64_t  mtime_ = -1;
+};
 
-    return ec == std::errc();
-}
+#ifdef QUICKLHE_WITH_CURL
+// one connection, kept alive across the range requests
+class CurlFile : public RemoteFile
+{
+public:
+    // size and mtime as `known` has them, else from a HEAD request
+    CurlFile(const std::string& url, const InputInfo* known) : url_(url)
+    {
+        static const CURLcode global = curl_global_init(CURL_GLOBAL_DEFAULT);
+        if (global != CURLE_OK || !(curl_ = curl_easy_init()))
+            throw std::runtime_error("Cannot initialise libcurl");
+        curl_easy_setopt(curl_, CURLOPT_URL, url_.c_str());
+        curl_easy_setopt(curl_, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl_, CURLOPT_FAILONERROR, 1L);
+        curl_easy_setopt(curl_, CURLOPT_NOSIGNAL, 1L);     // reads run on worker threads
 
-//process header and particles from event and put them directly into struct
-void processEvent(ParseState* s)
-{   
-    std::string_view sv(s->charBuf);
- 
-    // read headder (careful to save n_ptc for looping condation below)
-    int n_ptc = 0; 
-    if (!consume_next(sv, n_ptc)) throw std::runtime_error("Failed to parse particle count from event number: " + std::to_string(s->cur_event));
+        if (known) {
+            size_  = known->size;
+            mtime_ = known->mtime;
+        } else {
+            // size and modification time from the headers alone
+            curl_easy_setopt(curl_, CURLOPT_NOBODY, 1L);
+            curl_easy_setopt(curl_, CURLOPT_FILETIME, 1L);
+            perform();
+            curl_off_t length = -1, time = -1;
+            curl_easy_getinfo(curl_, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+            curl_easy_getinfo(curl_, CURLINFO_FILETIME_T, &time);
+            if (length < 0)
+                throw std::runtime_error(url_ + ": the server sends no Content-Length, which range reads need");
+            size_  = static_cast<uint64_t>(length);
+            mtime_ = static_cast<int64_t>(time);
+        }
 
-    int* ie = s->ievt_arr + s->cur_event * 2;
-    ie[0] = n_ptc;
-    consume_next(sv, ie[1]);
+        curl_easy_setopt(curl_, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, &CurlFile::write);
+        curl_easy_setopt(curl_, CURLOPT_WRITEDATA, this);
+    }
+    ~CurlFile() override { curl_easy_cleanup(curl_); }
 
-    double* fe = s->fevt_arr + s->cur_event * (4 + s->n_weights);
-    for (int i = 0; i < 4; i++) { // read doubles
-        consume_next(sv, fe[i]);
+    size_t readAt(uint64_t offset, char* buf, size_t n) override
+    {
+        if (offset >= size_ || n == 0) return 0;
+        n = static_cast<size_t>(std::min<uint64_t>(n, size_ - offset));
+        std::string range = std::to_string(offset) + "-" + std::to_string(offset + n - 1);
+        curl_easy_setopt(curl_, CURLOPT_RANGE, range.c_str());
+        out_  = buf;
+        want_ = n;
+        got_  = 0;
+        overflow_ = false;
+        perform();
+        return got_;
     }
 
-    // read particles 
-    for (int p = 0; p < n_ptc; p++) {
-        int*    ip = s->iptc_arr + s->cur_particle * 7;
-        double* fp = s->fptc_arr + s->cur_particle * 7;
-        ip[0] = s->cur_event+1; //event number is 1-indexed on user-facing side
-        // first 6 ints
-        for (int i = 1; i <= 6; i++) {
-            consume_next(sv, ip[i]);
+private:
+    // more bytes than asked for: the server ignored the Range header
+    static size_t write(char* data, size_t size, size_t count, void* ud)
+    {
+        CurlFile* self = static_cast<CurlFile*>(ud);
+        size_t n = size * count;
+        if (n > self->want_ - self->got_) {
+            self->overflow_ = true;
+            return 0;  // aborts the transfer
         }
-        // remaining 7 doubles
-        for (int i = 0; i < 7; ++i) {
-            consume_next(sv, fp[i]);
+        std::memcpy(self->out_ + self->got_, data, n);
+        self->got_ += n;
+        return n;
+    }
+
+    void perform()
+    {
+        CURLcode ret = curl_easy_perform(curl_);
+        if (overflow_)
+            throw std::runtime_error(url_ + ": the server does not support range requests");
+        if (ret != CURLE_OK)
+            throw std::runtime_error(url_ + ": " + curl_easy_strerror(ret));
+    }
+
+    std::string url_;
+    CURL*       curl_ = nullptr;
+    char*       out_  = nullptr;
+    size_t      want_ = 0, got_ = 0;
+    bool        overflow_ = false;
+};
+#endif
+
+#ifdef QUICKLHE_WITH_XROOTD
+class XrdFile : public RemoteFile
+{
+public:
+    // size and mtime as `known` has them, else from a stat
+    XrdFile(const std::string& url, const InputInfo* known) : url_(url)
+    {
+        XrdCl::XRootDStatus st = file_.Open(url, XrdCl::OpenFlags::Read);
+        if (!st.IsOK()) throw std::runtime_error("Cannot open " + url + ": " + st.ToString());
+        if (known) {
+            size_  = known->size;
+            mtime_ = known->mtime;
+            return;
         }
-        s->cur_particle++;
+        XrdCl::StatInfo* info = nullptr;
+        st = file_.Stat(false, info);
+        if (!st.IsOK() || !info) throw std::runtime_error("Cannot stat " + url + ": " + st.ToString());
+        size_  = info->GetSize();
+        mtime_ = static_cast<int64_t>(info->GetModTime());
+        delete info;
     }
+    ~XrdFile() override { file_.Close(); }
 
-    // some files have additional metadata marked '#'
-    // if necessary, parse those line here.
+    size_t readAt(uint64_t offset, char* buf, size_t n) override
+    {
+        size_t done = 0;
+        while (done < n && offset + done < size_) {
+            uint32_t want = static_cast<uint32_t>(std::min<size_t>(n - done, UINT32_MAX)), got = 0;
+            XrdCl::XRootDStatus st = file_.Read(offset + done, want, buf + done, got);
+            if (!st.IsOK()) throw std::runtime_error("xrootd error reading " + url_ + ": " + st.ToString());
+            if (got == 0) break;
+            done += got;
+        }
+        return done;
+    }
+
+private:
+    std::string  url_;
+    XrdCl::File  file_;
+};
+#endif
+
+static bool startsWith(std::string_view sv, std::string_view prefix)
+{
+    return sv.substr(0, prefix.size()) == prefix;
 }
 
-static void processWeight(ParseState* s)
+// names that are URLs rather than paths
+static bool isRemote(const std::string& filename)
 {
-    std::string_view sv(s->charBuf);
-    double* fe = s->fevt_arr + s->cur_event * (4 + s->n_weights);
-    consume_next(sv, fe[4 + s->cur_weight++]);
-    s->charBuf.clear();
-    s->capture = NO_CAPTURE;
+    return startsWith(filename, "http://") || startsWith(filename, "https://")
+        || startsWith(filename, "root://") || startsWith(filename, "xroot://");
 }
 
-// -- SAX callbacks --
+// `known`: the probed size and mtime, saving the request that would fetch them again
+static std::unique_ptr<RemoteFile> openRemote(const std::string& url, const InputInfo* known = nullptr)
+{
+    if (startsWith(url, "root://") || startsWith(url, "xroot://")) {
+#ifdef QUICKLHE_WITH_XROOTD
+        return std::make_unique<XrdFile>(url, known);
+#else
+        throw std::runtime_error(url + " needs lhe_parser built with QUICKLHE_WITH_XROOTD");
+#endif
+    }
+#ifdef QUICKLHE_WITH_CURL
+    return std::make_unique<CurlFile>(url, known);
+#else
+    throw std::runtime_error(url + " needs lhe_parser built with QUICKLHE_WITH_CURL");
+#endif
+}
 
-static void XMLCALL onStart(void* ud, const XML_Char* name, const XML_Char** attributes)
+// [offset, offset + length) of a remote file, one range request per read
+class RemoteSource : public ByteSource
 {
-    ParseState* s = static_cast<ParseState*>(ud);
+public:
+    RemoteSource(std::unique_ptr<RemoteFile> file, size_t offset, size_t length)
+        : file_(std::move(file)), pos_(offset), left_(length) {}
 
-    if (std::strcmp(name, "event") == 0) {
-        s->capture = EVENT_HEADER;
-        s->cur_weight = 0;
-    } else if (s->capture == EVENT_HEADER) {
-        // for header, next <tag> is equivalent to onEnd(...) because header has no enclosing tag
-        processEvent(s);
-        // simularly, particle lines have no tag, so they must be processed without callbacks
-        s->charBuf.clear(); //end of event-level data (remainder has enclosing tags)
-        s->capture = NO_CAPTURE;
+    size_t read(char* buf, size_t n) override
+    {
+        size_t got = file_->readAt(pos_, buf, std::min(n, left_));
+        pos_  += got;
+        left_ -= got;
+        return got;
     }
 
-    if (std::strcmp(name, "wgt") == 0)
-        s->capture = WGT_TAG;
-    else if (std::strcmp(name, "initrwgt") == 0)
-        s->capture = REWGT_BLOCK;
-    else if (s->capture == REWGT_BLOCK) {
-        if (std::strcmp(name, "weightgroup") == 0) {
-            py::dict d;
-            for (int i = 0; attributes[i]; i += 2) {
-                if (std::strcmp(attributes[i], "name") == 0) {
-                    s->current_rwgt_group = py::str(attributes[i+1]);
-                    s->reweight[attributes[i+1]] = d;
-                } else if (std::strcmp(attributes[i], "combine") == 0) {
-                    d["combine"] = py::str(attributes[i+1]);
+private:
+    std::unique_ptr<RemoteFile> file_;
+    uint64_t                    pos_;
+    size_t                      left_;
+};
+
+// [offset, offset + length) of an uncompressed file, local or remote
+static std::unique_ptr<ByteSource> openRange(const std::string& filename, size_t offset = 0,
+                                             size_t length = std::string::npos, const InputInfo* known = nullptr)
+{
+    if (isRemote(filename)) return std::make_unique<RemoteSource>(openRemote(filename, known), offset, length);
+    return std::make_unique<FileSource>(filename, offset, length);
+}
+
+// gzip (or zlib) stream; concatenated members, as written by parallel compressors, are
+// decoded one after the other
+class GzipSource : public ByteSource
+{
+public:
+    explicit GzipSource(std::unique_ptr<ByteSource> in) : in_(std::move(in))
+    {
+        if (inflateInit2(&z_, 15 + 32) != Z_OK) // 32: detect gzip/zlib header
+            throw std::runtime_error("Cannot initialise zlib");
+    }
+    ~GzipSource() override { inflateEnd(&z_); }
+
+    size_t read(char* buf, size_t n) override
+    {
+        z_.next_out  = reinterpret_cast<Bytef*>(buf);
+        z_.avail_out = static_cast<uInt>(std::min<size_t>(n, UINT32_MAX));
+        while (z_.avail_out > 0 && !eof_) {
+            if (z_.avail_in == 0) {
+                std::string_view v = in_->next();
+                if (v.empty()) {
+                    if (!member_end_) throw std::runtime_error("Truncated gzip stream");
+                    eof_ = true;
+                    break;
                 }
+                z_.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(v.data()));
+                z_.avail_in = static_cast<uInt>(v.size());
             }
-        } else if (std::strcmp(name, "weight") == 0) {
-            // <weight id="3" MUR="0.5"  MUF="0.5"  DYN_SCALE="2"  PDF="247000" > MUR=0.5 MUF=0.5 dyn_scale_choice=HT  </weight>
-            py::dict d;
-            for (int i = 0; attributes[i]; i += 2) {
-                if (std::strcmp(attributes[i], "id") == 0) {
-                    int id = std::atoi(attributes[i+1]);
-                    s->current_rwgt_id = id;
-                    s->reweight[py::str(s->current_rwgt_group)][py::int_(id)] = d; // convert id (key) to int
-                } else if (std::strcmp(attributes[i], "MUR") == 0 || std::strcmp(attributes[i], "MUF") == 0) {
-                    d[py::str(attributes[i])] = py::float_(std::atof(attributes[i+1]));
-                } else if (std::strcmp(attributes[i], "DYN_SCALE") == 0) {
-                    d[py::str(attributes[i])] = py::int_(std::atoi(attributes[i+1]));
-                } else {
-                    d[py::str(attributes[i])] = py::str(attributes[i+1]);
+            if (member_end_) { // more input after a complete member: start the next one
+                inflateReset(&z_);
+                member_end_ = false;
+            }
+            int ret = inflate(&z_, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) member_end_ = true;
+            else if (ret != Z_OK && ret != Z_BUF_ERROR)
+                throw std::runtime_error(std::string("gzip error: ") + (z_.msg ? z_.msg : "corrupt input"));
+        }
+        return n - z_.avail_out;
+    }
+
+private:
+    std::unique_ptr<ByteSource> in_;
+    z_stream z_{};
+    bool     member_end_ = false;
+    bool     eof_        = false;
+};
+
+// xz / lzma stream, concatenated streams included
+class XzSource : public ByteSource
+{
+public:
+    explicit XzSource(std::unique_ptr<ByteSource> in) : in_(std::move(in))
+    {
+        if (lzma_stream_decoder(&z_, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+            throw std::runtime_error("Cannot initialise liblzma");
+    }
+    ~XzSource() override { lzma_end(&z_); }
+
+    size_t read(char* buf, size_t n) override
+    {
+        z_.next_out  = reinterpret_cast<uint8_t*>(buf);
+        z_.avail_out = n;
+        while (z_.avail_out > 0 && !eof_) {
+            if (z_.avail_in == 0 && action_ == LZMA_RUN) {
+                std::string_view v = in_->next();
+                if (v.empty()) action_ = LZMA_FINISH;
+                z_.next_in  = reinterpret_cast<const uint8_t*>(v.data());
+                z_.avail_in = v.size();
+            }
+            lzma_ret ret = lzma_code(&z_, action_);
+            if (ret == LZMA_STREAM_END) eof_ = true;
+            else if (ret != LZMA_OK)
+                throw std::runtime_error("xz error: corrupt or truncated input (code " + std::to_string(ret) + ")");
+        }
+        return n - z_.avail_out;
+    }
+
+private:
+    std::unique_ptr<ByteSource> in_;
+    lzma_stream z_ = LZMA_STREAM_INIT;
+    lzma_action action_ = LZMA_RUN;
+    bool        eof_    = false;
+};
+
+#ifdef QUICKLHE_WITH_ZSTD
+// zstd stream; the decoder continues across concatenated frames by itself
+class ZstdSource : public ByteSource
+{
+public:
+    explicit ZstdSource(std::unique_ptr<ByteSource> in) : in_(std::move(in)), z_(ZSTD_createDStream())
+    {
+        if (!z_ || ZSTD_isError(ZSTD_initDStream(z_)))
+            throw std::runtime_error("Cannot initialise zstd");
+    }
+    ~ZstdSource() override { ZSTD_freeDStream(z_); }
+
+    size_t read(char* buf, size_t n) override
+    {
+        ZSTD_outBuffer out{buf, n, 0};
+        while (out.pos < out.size && !eof_) {
+            if (in_buf_.pos == in_buf_.size) {
+                std::string_view v = in_->next();
+                if (v.empty()) {
+                    if (pending_) throw std::runtime_error("Truncated zstd stream");
+                    eof_ = true;
+                    break;
                 }
+                in_buf_ = {v.data(), v.size(), 0};
             }
+            size_t ret = ZSTD_decompressStream(z_, &out, &in_buf_);
+            if (ZSTD_isError(ret))
+                throw std::runtime_error(std::string("zstd error: ") + ZSTD_getErrorName(ret));
+            pending_ = ret != 0; // 0 once a frame is complete
         }
+        return out.pos;
     }
-}
 
-static void XMLCALL onEnd(void* ud, const XML_Char* name)
+private:
+    std::unique_ptr<ByteSource> in_;
+    ZSTD_DStream*  z_;
+    ZSTD_inBuffer  in_buf_{nullptr, 0, 0};
+    bool           pending_ = false;
+    bool           eof_     = false;
+};
+#endif
+
+// runs another source on its own thread, keeping `depth` blocks filled ahead of the
+// consumer, so e.g. inflating and parsing overlap; blocks are handed out without a copy
+class PrefetchSource : public ByteSource
 {
-    ParseState* s = static_cast<ParseState*>(ud);
+public:
+    PrefetchSource(std::unique_ptr<ByteSource> in, size_t depth, size_t block_size)
+        : in_(std::move(in)), blocks_(std::max<size_t>(depth, 2))
+    {
+        for (size_t i = 0; i < blocks_.size(); ++i) {
+            blocks_[i].data.resize(block_size);
+            free_.push_back(i);
+        }
+        worker_ = std::thread([this] { produce(); });
+    }
 
-    if (std::strcmp(name, "event") == 0)
-        s->cur_event++;
-    else if (std::strcmp(name, "wgt") == 0)
-        processWeight(s);
-    else if (std::strcmp(name, "initrwgt") == 0)
-        s->capture = NO_CAPTURE;
-    else if (std::strcmp(name, "weight") == 0) {
-        s->reweight[py::str(s->current_rwgt_group)][py::int_(s->current_rwgt_id)][py::str("contents")] = std::string(s->charBuf);
-        s->charBuf.clear();
+    ~PrefetchSource() override
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        worker_.join();
+    }
+
+    std::string_view next() override
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        if (current_ != NONE) { // the consumer is done with the previous block
+            free_.push_back(current_);
+            current_ = NONE;
+            cv_.notify_all();
+        }
+        cv_.wait(lk, [this] { return !full_.empty(); });
+        size_t i = full_.front();
+        if (blocks_[i].size == 0) { // end marker stays queued
+            if (error_) std::rethrow_exception(error_);
+            return {};
+        }
+        full_.pop_front();
+        current_ = i;
+        return {blocks_[i].data.data(), blocks_[i].size};
+    }
+
+    size_t read(char* buf, size_t n) override
+    {
+        if (rest_.empty()) rest_ = next();
+        size_t got = std::min(n, rest_.size());
+        if (got) std::memcpy(buf, rest_.data(), got);  // rest_ is null at the end
+        rest_.remove_prefix(got);
+        return got;
+    }
+
+private:
+    static constexpr size_t NONE = static_cast<size_t>(-1);
+    struct Block { std::vector<char> data; size_t size = 0; };
+
+    void produce()
+    {
+        while (true) {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lk(mutex_);
+                cv_.wait(lk, [this] { return stop_ || !free_.empty(); });
+                if (stop_) return;
+                i = free_.front();
+                free_.pop_front();
+            }
+
+            Block& b = blocks_[i];
+            b.size = 0;
+            std::exception_ptr error;
+            try {
+                size_t got;
+                while (b.size < b.data.size() && (got = in_->read(b.data.data() + b.size, b.data.size() - b.size)) > 0)
+                    b.size += got;
+            } catch (...) {
+                error = std::current_exception();
+                b.size = 0;
+            }
+
+            bool end = b.size == 0;
+            {
+                std::lock_guard<std::mutex> lk(mutex_);
+                if (error) error_ = error;
+                full_.push_back(i);
+            }
+            cv_.notify_all();
+            if (end) return;
+        }
+    }
+
+    std::unique_ptr<ByteSource> in_;
+    std::vector<Block>          blocks_;
+    std::deque<size_t>          free_, full_;
+    size_t                      current_ = NONE;
+    std::string_view            rest_;
+    std::exception_ptr          error_;
+    bool                        stop_ = false;
+    std::mutex                  mutex_;
+    std::condition_variable     cv_;
+    std::thread                 worker_;
+};
+
+// stats=True: counts the bytes passing through
+class CountingSource : public ByteSource
+{
+public:
+    CountingSource(std::unique_ptr<ByteSource> in, uint64_t& bytes) : in_(std::move(in)), bytes_(bytes) {}
+
+    std::string_view next() override
+    {
+        std::string_view block = in_->next();
+        bytes_ += block.size();
+        return block;
+    }
+
+    size_t read(char* buf, size_t n) override
+    {
+        size_t got = in_->read(buf, n);
+        bytes_ += got;
+        return got;
+    }
+
+private:
+    std::unique_ptr<ByteSource> in_;
+    uint64_t&                   bytes_;
+};
+
+static InputInfo probeInput(const std::string& filename)
+{
+    InputInfo input;
+    unsigned char magic[6] = {};
+    if (isRemote(filename)) {
+        std::unique_ptr<RemoteFile> remote = openRemote(filename);
+        remote->readAt(0, reinterpret_cast<char*>(magic), sizeof(magic));
+        input.size  = remote->size();
+        input.mtime = remote->mtime();
+    } else {
+        std::ifstream f(filename, std::ios::binary);
+        if (!f.is_open())
+            throw std::runtime_error("Cannot open file: " + filename);
+        f.read(reinterpret_cast<char*>(magic), sizeof(magic));
+        struct stat st;
+        if (::stat(filename.c_str(), &st) != 0)
+            throw std::runtime_error("Cannot stat file: " + filename);
+        input.size  = static_cast<uint64_t>(st.st_size);
+        input.mtime = static_cast<int64_t>(st.st_mtime);
     }
+    if (magic[0] == 0x1f && magic[1] == 0x8b)                  input.format = FORMAT_GZIP;
+    else if (std::memcmp(magic, "\xfd" "7zXZ\0", 6) == 0)      input.format = FORMAT_XZ;
+    else if (std::memcmp(magic, "\x28\xb5\x2f\xfd", 4) == 0)   input.format = FORMAT_ZSTD;
+    return input;
 }
 
-static void XMLCALL onChar(void* ud, const XML_Char* buf, int len)
+// how streamed (not memory-mapped) input is read
+struct ReadOptions
 {
-    auto* s = static_cast<ParseState*>(ud);
-    if (s->capture)
-        s->charBuf.append(buf, len);
+    size_t chunk_size    = CHUNK;     // chunk_size=: bytes read into expat's buffer at a time
+    int    prefetch      = -1;        // prefetch=: blocks kept filled ahead by a reader thread;
+                                      // -1 compressed or remote input only (4 blocks), 0 none
+    size_t prefetch_size = 4 * CHUNK; // prefetch_size=: bytes per block
+};
+
+// src as read through a prefetching thread, if the options ask for one; compressed and
+// remote input get one by default (`background`), so inflating or waiting on the network
+// overlaps parsing
+static std::unique_ptr<ByteSource> prefetched(std::unique_ptr<ByteSource> src, const ReadOptions& reading,
+                                              bool background)
+{
+    int depth = reading.prefetch < 0 ? (background ? 4 : 0) : reading.prefetch;
+    if (depth == 0) return src;
+    return std::make_unique<PrefetchSource>(std::move(src), depth, reading.prefetch_size);
 }
 
-// ---------------------------------------------------------------------------
-// Main entry point exposed to Python
-// double passes LHE file, first to extract numbers of events, weights, and particles,
-// then to read all values into preallocated arrays passed directly into nupmy structures by pybind11
-// ---------------------------------------------------------------------------
-py::tuple parseLHE(const std::string& filename)
+// decompressed contents of the file; decompression runs on its own thread, and so does
+// reading a plain file with prefetch=
+static std::unique_ptr<ByteSource> openSource(const std::string& filename, const InputInfo& input,
+                                              const ReadOptions& reading = {})
 {
-    // --- Pass 1 ---
-    auto [n_events, n_weights, n_particles] = countDimensions(filename);
+    std::unique_ptr<ByteSource> src = openRange(filename, 0, std::string::npos, &input);
+    switch (input.format) {
+        case FORMAT_GZIP: src = std::make_unique<GzipSource>(std::move(src)); break;
+        case FORMAT_XZ:   src = std::make_unique<XzSource>(std::move(src));   break;
+        case FORMAT_ZSTD:
+#ifdef QUICKLHE_WITH_ZSTD
+            src = std::make_unique<ZstdSource>(std::move(src));
+            break;
+#else
+            throw std::runtime_error(filename + " is zstd compressed, but lhe_parser was built without QUICKLHE_WITH_ZSTD");
+#endif
+        default:          return prefetched(std::move(src), reading, isRemote(filename));
+    }
+    return prefetched(std::move(src), reading, true);
+}
 
-    if (n_events == 0 || n_weights == 0 || n_particles == 0) 
-        throw std::runtime_error("Found no events, weights, or particles.");
+// private mapping of a whole file, unmapped on destruction; read-only, or with
+// copy_on_write writable pages whose changes never reach the file
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& filename, bool copy_on_write = false)
+    {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open file: " + filename);
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot stat file: " + filename);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            int prot = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+            void* p = ::mmap(nullptr, size_, prot, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Cannot map file: " + filename);
+            }
+            data_ = static_cast<char*>(p);
+            // hints only: failures (e.g. no file-backed THP) are harmless
+            ::madvise(p, size_, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+            ::madvise(p, size_, MADV_HUGEPAGE);
+#endif
+        }
+        ::close(fd);
+    }
+    ~MappedFile() { if (data_) ::munmap(data_, size_); }
 
-    // Double Arrays
-    py::array_t<double> f_evt({n_events, 4 + n_weights});
-    py::array_t<double> f_ptc({n_particles, 7});
-    auto f_evt_buf = f_evt.request();
-    auto f_ptc_buf = f_ptc.request();
-    std::memset(f_evt_buf.ptr, 0, sizeof(double) * n_events * (4 + n_weights));
-    std::memset(f_ptc_buf.ptr, 0, sizeof(double) * n_particles * 7);
-
-    // Int Arrays
-    py::array_t<int> i_evt({n_events, 2});
-    py::array_t<int> i_ptc({n_particles, 7});
-    auto i_evt_buf = i_evt.request();
-    auto i_ptc_buf = i_ptc.request();
-    std::memset(i_evt_buf.ptr, 0, sizeof(int) * n_events * 2);
-    std::memset(i_ptc_buf.ptr, 0, sizeof(int) * n_particles * 7);
-
-    std::ifstream f(filename, std::ios::binary);
-    if (!f.is_open())
-        throw std::runtime_error("Cannot open file: " + filename);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
 
-    ParseState state;
+    std::string_view view() const { return {data_, size_}; }
+    char* data() const { return data_; }  // writable with copy_on_write only
+
+private:
+    char*       data_ = nullptr;
+    size_t      size_ = 0;
+};
 
-    // Assigning to the state struct
-    state.fevt_arr = static_cast<double*>(f_evt_buf.ptr);
-    state.fptc_arr = static_cast<double*>(f_ptc_buf.ptr);
-    state.ievt_arr    = static_cast<int*>(i_evt_buf.ptr);
-    state.iptc_arr    = static_cast<int*>(i_ptc_buf.ptr);
+// ---------------------------------------------------------------------------
+// Pass 1 – line scan to count events and weights
+// ---------------------------------------------------------------------------
 
-    state.n_events  = n_events;
-    state.n_weights = n_weights;
-    state.n_particles = n_particles;
+// "<event>" or "<event npLO=...>", but not e.g. "<eventgroup>"
+static size_t findEventTag(std::string_view sv, size_t from = 0)
+{
+    for (size_t pos = sv.find("<event", from); pos != std::string_view::npos; pos = sv.find("<event", pos + 1)) {
+        if (pos + 6 < sv.size() && (sv[pos + 6] == '>' || std::isspace(static_cast<unsigned char>(sv[pos + 6]))))
+            return pos;
+    }
+    return std::string_view::npos;
+}
 
-    XML_Parser parser = XML_ParserCreate(nullptr);
-    XML_SetUserData(parser, &state);
-    XML_SetElementHandler(parser, onStart, onEnd);
-    XML_SetCharacterDataHandler(parser, onChar);
+struct Dimensions
+{
+    int64_t n_events    = 0;
+    int     n_weights   = 0;
+    int64_t n_particles = 0;
+    int64_t n_line      = 0;
+    std::vector<std::string> weight_ids; // id= of each <weight>, "" when it has none
+    bool    weightinfo  = false;             // the ids so far are LHEF 2 <weightinfo> names
 
-    constexpr size_t CHUNK = 65536;
-    char chunk[CHUNK];
-    bool parseError = false;
-    std::string errorMsg;
+    // build_index: file offset of every <event> tag and its particle count, recorded when
+    // `base` is set, to the byte at file offset `base_offset` (the mapped file, or a block)
+    const char*          base = nullptr;
+    int64_t              base_offset = 0;
+    std::vector<int64_t> event_offsets;
+    std::vector<int32_t> event_particles;
+};
 
-    while (f.read(chunk, CHUNK) || f.gcount() > 0)
-    {
-        int bytes   = static_cast<int>(f.gcount());
-        int isFinal = f.eof() ? 1 : 0;
+// value of attribute `name` in the tag at the start of `tag`, "" if absent; pass 1 only
+// needs the <weight> ids for weights=, the header is parsed properly by expat later
+static std::string attributeValue(std::string_view tag, std::string_view name)
+{
+    tag = tag.substr(0, tag.find('>'));
+    for (size_t pos = tag.find(name); pos != std::string_view::npos; pos = tag.find(name, pos + 1)) {
+        if (pos == 0 || !std::isspace(static_cast<unsigned char>(tag[pos - 1]))) continue;
+        size_t eq = tag.find_first_not_of(" \t", pos + name.size());
+        if (eq == std::string_view::npos || tag[eq] != '=') continue;
+        size_t q = tag.find_first_not_of(" \t", eq + 1);
+        if (q == std::string_view::npos || (tag[q] != '"' && tag[q] != '\'')) continue;
+        size_t close = tag.find(tag[q], q + 1);
+        if (close == std::string_view::npos) break;
+        return std::string(tag.substr(q + 1, close - q - 1));
+    }
+    return {};
+}
 
-        if (XML_Parse(parser, chunk, bytes, isFinal) == XML_STATUS_ERROR)
-        {
-            parseError = true;
-            errorMsg   = std::string("Expat error at line ")
-                       + std::to_string(XML_GetCurrentLineNumber(parser))
-                       + ": "
-                       + XML_ErrorString(XML_GetErrorCode(parser));
-            break;
+// counts the complete lines of data and returns the bytes consumed; unless `final`, it stops
+// early at an incomplete line, or at an event tag whose header line is not complete yet
+static size_t countLines(std::string_view data, Dimensions& d, bool final)
+{
+    size_t pos = 0;
+    auto getline = [&](size_t from, std::string_view& line) {
+        size_t nl = data.find('\n', from);
+        if (nl == std::string_view::npos) {
+            if (!final) return std::string_view::npos;
+            nl = data.size();
+        }
+        line = data.substr(from, nl - from);
+        return nl + 1;
+    };
+
+    std::string_view line;
+    while (pos < data.size()) {
+        size_t next = getline(pos, line);
+        if (next == std::string_view::npos) break;
+        size_t event_tag = findEventTag(line);
+        if (event_tag != std::string_view::npos) {
+            const char* tag_ptr = line.data() + event_tag;
+            // the particle count is on the line after the tag
+            size_t after = next < data.size() ? getline(next, line) : std::string_view::npos;
+            if (after == std::string_view::npos) {
+                if (!final) break;
+                line  = {};   // tag on the very last line
+                after = next;
+            }
+            ++d.n_events;
+            d.n_line += 2;
+            size_t begin = line.find_first_not_of(" \t\r");
+            int n;
+            if (begin == std::string_view::npos
+                || std::from_chars(line.data() + begin, line.data() + line.size(), n).ec != std::errc())
+                throw std::runtime_error("Failed to parse particle count from event header on line: " + std::to_string(d.n_line));
+            d.n_particles += n;
+            if (d.base) {
+                d.event_offsets.push_back(d.base_offset + (tag_ptr - d.base));
+                d.event_particles.push_back(n);
+            }
+            next = after;
+        } else {
+            ++d.n_line;
         }
 
-        if (isFinal) break;
+        // the weights are declared once: by <initrwgt>'s <weight>s, else by LHEF 2 <weightinfo>s
+        size_t tag = line.find("<weight ");
+        if (tag != std::string_view::npos) {
+            if (d.weightinfo) {
+                d.n_weights  = 0;
+                d.weightinfo = false;
+                d.weight_ids.clear();
+            }
+            ++d.n_weights;
+            d.weight_ids.push_back(attributeValue(line.substr(tag), "id"));
+        } else if ((tag = line.find("<weightinfo ")) != std::string_view::npos && (d.n_weights == 0 || d.weightinfo)) {
+            ++d.n_weights;
+            d.weightinfo = true;
+            d.weight_ids.push_back(attributeValue(line.substr(tag), "name"));
+        }
+        pos = next;
     }
 
-    XML_ParserFree(parser);
+    return std::min(pos, data.size());
+}
+
+// with offset >= 0, the file offset of the source's first byte, the event offsets are
+// recorded as well
+static Dimensions countDimensions(ByteSource& src, int64_t offset = -1)
+{
+    Dimensions d;
+    std::string carry; // incomplete lines from the end of the previous block
+
+    while (true) {
+        std::string_view block = src.next();
+        bool final = block.empty();
+        std::string_view data = block;
+        if (!carry.empty() || final) {
+            carry.append(block);
+            data = carry;
+        }
+        if (offset >= 0) {
+            d.base        = data.data();
+            d.base_offset = offset;
+        }
+        size_t used = countLines(data, d, final);
+        if (offset >= 0) offset += static_cast<int64_t>(used);
+        if (final) break;
+        if (data.data() == block.data()) carry.assign(block.substr(used));
+        else carry.erase(0, used);
+    }
 
-    if (parseError)
-        throw std::runtime_error(errorMsg);
+    d.base = nullptr;
+    return d;
+}
 
-    return py::make_tuple(state.reweight, i_evt, f_evt, i_ptc, f_ptc);
+// same scan over a file that is already in memory (mmap)
+static Dimensions countDimensions(std::string_view data)
+{
+    Dimensions d;
+    countLines(data, d, true);
+    return d;
 }
 
 // ---------------------------------------------------------------------------
-// pybind11 module
+// Pass 2 – SAX parse with expat to fill the array
 // ---------------------------------------------------------------------------
-PYBIND11_MODULE(lhe_parser, m)
+static constexpr int NO_CAPTURE   = 0;
+static constexpr int EVENT_HEADER = 1;
+static constexpr int WGT_TAG      = 2;
+static constexpr int REWGT_BLOCK  = 3;
+static constexpr int WGTS_BLOCK   = 4;  // <weights>: all weights of the event at once
+static constexpr int MGRWT_ENTRY  = 5;  // <rscale>, <asrwt>, <pdfrwt>, <totfact> in <mgrwt>
+static constexpr int INIT_BLOCK   = 6;  // numbers of <init>, up to its first child element
+
+// single-pass mode: initial capacity, and number of events after which the
+// capacity is re-estimated from the file size and the bytes consumed so far
+static constexpr size_t GROW_INIT_EVENTS    = 1024;
+static constexpr size_t GROW_INIT_PARTICLES = 16 * GROW_INIT_EVENTS;
+
+// block of rows that grows with realloc (large blocks are remapped, not copied)
+// and is handed to numpy without a copy once parsing is done; new rows are left as they
+// are, every event clears its own (OutputArray::clearRows)
+struct GrowableBuffer
 {
-    m.doc() = "Fast LHE parser";
-    m.def("parse_lhe", &parseLHE, py::arg("filename"),
-          "Parse an LHE file.");
+    char*  data     = nullptr;
+    size_t capacity = 0;                 // rows
+
+    ~GrowableBuffer() { std::free(data); }
+
+    void reserve(size_t rows, size_t row_bytes)
+    {
+        if (rows <= capacity) return;
+        char* p = static_cast<char*>(std::realloc(data, std::max<size_t>(rows * row_bytes, 1)));
+        if (!p) throw std::bad_alloc();
+        data     = p;
+        capacity = rows;
+    }
+
+    void swap(GrowableBuffer& other)
+    {
+        std::swap(data, other.data);
+        std::swap(capacity, other.capacity);
+    }
+};
+
+// element types of the output arrays; the narrow ones are used by compact=True
+static constexpr int DT_INT32   = 0;
+static constexpr int DT_INT64   = 1;
+static constexpr int DT_FLOAT64 = 2;
+static constexpr int DT_FLOAT32 = 3;
+static constexpr int DT_INT16   = 4;
+static constexpr int DT_INT8    = 5;
+
+static size_t dtypeSize(int dtype)
+{
+    switch (dtype) {
+        case DT_INT8:    return 1;
+        case DT_INT16:   return 2;
+        case DT_INT32:
+        case DT_FLOAT32: return 4;
+        default:         return 8;
+    }
+}
+
+static py::dtype numpyDtype(int dtype)
+{
+    switch (dtype) {
+        case DT_INT8:    return py::dtype::of<int8_t>();
+        case DT_INT16:   return py::dtype::of<int16_t>();
+        case DT_INT32:   return py::dtype::of<int32_t>();
+        case DT_INT64:   return py::dtype::of<int64_t>();
+        case DT_FLOAT32: return py::dtype::of<float>();
+        default:         return py::dtype::of<double>();
+    }
+}
+
+static int dtypeCode(const py::dtype& dt)
+{
+    if (dt.kind() == 'f' && dt.itemsize() == 8) return DT_FLOAT64;
+    if (dt.kind() == 'f' && dt.itemsize() == 4) return DT_FLOAT32;
+    if (dt.kind() == 'i' && dt.itemsize() == 8) return DT_INT64;
+    if (dt.kind() == 'i' && dt.itemsize() == 4) return DT_INT32;
+    if (dt.kind() == 'i' && dt.itemsize() == 2) return DT_INT16;
+    if (dt.kind() == 'i' && dt.itemsize() == 1) return DT_INT8;
+    throw std::runtime_error("Unsupported array dtype");
+}
+
+// index_dtype option: element type of i_ptc, whose evt_idx column overflows int32 on
+// merged samples with more than 2^31 events (an error, see narrowingError())
+static int parseIndexDtype(const std::string& name)
+{
+    if (name == "int32") return DT_INT32;
+    if (name == "int64") return DT_INT64;
+    throw std::invalid_argument("Unknown index_dtype '" + name + "', expected 'int32' or 'int64'");
+}
+
+// one column of an output array: the value of row r is at base + r * stride
+struct Column
+{
+    char*  base   = nullptr;
+    size_t stride = 0;
+    int    dtype  = DT_INT32;
+};
+
+// a value outside the range of the integer column it goes to raises instead of wrapping:
+// int32 (the default; index_dtype='int64' widens i_ptc), or the int16 / int8 columns of
+// compact=True
+[[noreturn]] static void narrowingError(int64_t v, int dtype)
+{
+    if (dtype == DT_INT32)
+        throw std::runtime_error(std::to_string(v) + " does not fit an int32 column; index_dtype='int64' "
+                                 "stores i_ptc as int64");
+    throw std::runtime_error("compact=True: " + std::to_string(v) + " does not fit an "
+                             + (dtype == DT_INT8 ? "int8 (ISTUP)" : "int16 (NUP, MOTHUP, ICOLUP)")
+                             + " column; parse this file without compact=True");
+}
+
+// v as the integer type of a column, checked
+template <typename Int>
+static inline Int narrowed(int64_t v)
+{
+    if (v != static_cast<Int>(v)) narrowingError(v, sizeof(Int) == 1 ? DT_INT8 : sizeof(Int) == 2 ? DT_INT16 : DT_INT32);
+    return static_cast<Int>(v);
+}
+
+static inline void storeInt(const Column& c, int64_t row, int64_t v)
+{
+    char* p = c.base + row * c.stride;
+    switch (c.dtype) {
+        case DT_INT32: *reinterpret_cast<int32_t*>(p) = narrowed<int32_t>(v); break;
+        case DT_INT16: *reinterpret_cast<int16_t*>(p) = narrowed<int16_t>(v); break;
+        case DT_INT8:  *reinterpret_cast<int8_t*>(p)  = narrowed<int8_t>(v);  break;
+        default:       *reinterpret_cast<int64_t*>(p) = v;
+    }
+}
+
+static inline int64_t loadInt(const Column& c, int64_t row)
+{
+    const char* p = c.base + row * c.stride;
+    switch (c.dtype) {
+        case DT_INT32: return *reinterpret_cast<const int32_t*>(p);
+        case DT_INT16: return *reinterpret_cast<const int16_t*>(p);
+        case DT_INT8:  return *reinterpret_cast<const int8_t*>(p);
+        default:       return *reinterpret_cast<const int64_t*>(p);
+    }
+}
+
+static inline void storeFloat(const Column& c, int64_t row, double v)
+{
+    char* p = c.base + row * c.stride;
+    if (c.dtype == DT_FLOAT32) *reinterpret_cast<float*>(p) = static_cast<float>(v);
+    else                       *reinterpret_cast<double*>(p) = v;
+}
+
+// layout option: how the columns of an output array are laid out in memory
+static constexpr int LAYOUT_ROWS     = 0;  // {rows, columns}, C order
+static constexpr int LAYOUT_COLUMNAR = 1;  // {rows, columns}, Fortran order
+static constexpr int LAYOUT_DICT     = 2;  // dict of 1-D arrays, one per column
+static constexpr int LAYOUT_ARROW    = 3;  // parsed as LAYOUT_DICT, handed out as ArrowEvents
+
+static int parseLayout(const std::string& name)
+{
+    if (name == "rows")     return LAYOUT_ROWS;
+    if (name == "columnar") return LAYOUT_COLUMNAR;
+    if (name == "dict")     return LAYOUT_DICT;
+    if (name == "arrow")    return LAYOUT_ARROW;
+    throw std::invalid_argument("Unknown layout '" + name + "', expected 'rows', 'columnar', 'dict' or 'arrow'");
+}
+
+// out=: one of the caller's arrays, which must take `rows` rows of `dtype` where they are
+static py::array outputTarget(py::handle obj, int ndim, size_t rows, int dtype, const std::string& what)
+{
+    if (!py::isinstance<py::array>(obj)) throw std::invalid_argument("out= " + what + " must be a numpy array");
+    auto a = py::reinterpret_borrow<py::array>(obj);
+    size_t item = dtypeSize(dtype);
+    if (a.ndim() != ndim)
+        throw std::invalid_argument("out= " + what + " must be " + std::to_string(ndim) + "-D");
+    if (a.dtype().kind() != numpyDtype(dtype).kind() || static_cast<size_t>(a.dtype().itemsize()) != item
+        || !a.dtype().attr("isnative").cast<bool>())
+        throw std::invalid_argument("out= " + what + " must have dtype " + py::str(numpyDtype(dtype)).cast<std::string>());
+    if (!a.writeable()) throw std::invalid_argument("out= " + what + " is read-only");
+    if (a.shape(0) < static_cast<py::ssize_t>(rows))
+        throw std::invalid_argument("out= " + what + " has room for " + std::to_string(a.shape(0)) + " rows, "
+                                    + std::to_string(rows) + " are needed");
+    bool aligned = reinterpret_cast<uintptr_t>(a.data()) % item == 0;
+    for (int i = 0; i < ndim; ++i) aligned = aligned && a.strides(i) >= 0 && a.strides(i) % static_cast<py::ssize_t>(item) == 0;
+    if (!aligned) throw std::invalid_argument("out= " + what + " must be aligned, with non-negative strides");
+    return a;
+}
+
+// one of the four output arrays: `fields` columns of one dtype (or, for layout='dict', one
+// per field), of which the ones not kept by columns=/weights= are neither parsed nor stored
+// (their Column has no base); in the column-major layouts each column holds `capacity`
+// rows while being filled and is compacted when handed out
+struct OutputArray
+{
+    int                      dtype  = DT_FLOAT64;
+    size_t                   fields = 0;
+    std::vector<std::string> names;      // dict keys; fields past the named ones are wgt_<i>
+    int                      layout = LAYOUT_ROWS;
+    std::vector<int>         field_dtypes; // per field (compact=True, layout='dict'); empty: dtype
+    std::vector<bool>        selected;   // per field; empty keeps them all
+    std::vector<Column>      cols;       // per field
+    GrowableBuffer           buf;        // storage in single-pass mode and for iter_lhe
+
+    OutputArray(int element_dtype, size_t n_fields, std::vector<std::string> field_names)
+        : dtype(element_dtype), fields(n_fields), names(std::move(field_names)) {}
+
+    bool   kept(size_t f) const { return selected.empty() || selected[f]; }
+    size_t width() const
+    {
+        size_t w = 0;
+        for (size_t f = 0; f < fields; ++f) w += kept(f);
+        return w;
+    }
+    size_t itemSize() const { return dtypeSize(dtype); }
+    int    fieldDtype(size_t f) const { return field_dtypes.empty() ? dtype : field_dtypes[f]; }
+    size_t fieldSize(size_t f) const { return dtypeSize(fieldDtype(f)); }
+    size_t rowBytes() const
+    {
+        if (field_dtypes.empty()) return width() * itemSize();
+        size_t bytes = 0;
+        for (size_t f = 0; f < fields; ++f)
+            if (kept(f)) bytes += fieldSize(f);
+        return bytes;
+    }
+
+    // where each kept field lies: its byte offset within a row (layout='rows'), or within
+    // the storage in units of the row capacity (column-major). Wider columns go first, so
+    // each one stays aligned whatever the capacity; npos for the fields not kept
+    std::vector<size_t> placement() const
+    {
+        std::vector<size_t> order;
+        for (size_t f = 0; f < fields; ++f)
+            if (kept(f)) order.push_back(f);
+        if (layout != LAYOUT_ROWS)
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return fieldSize(a) > fieldSize(b); });
+        std::vector<size_t> at(fields, std::string::npos);
+        size_t offset = 0;
+        for (size_t f : order) {
+            at[f] = offset;
+            offset += fieldSize(f);
+        }
+        return at;
+    }
+
+    // the kept fields in the order they lie in memory
+    std::vector<size_t> memoryOrder(const std::vector<size_t>& at) const
+    {
+        std::vector<size_t> order;
+        for (size_t f = 0; f < fields; ++f)
+            if (kept(f)) order.push_back(f);
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return at[a] < at[b]; });
+        return order;
+    }
+
+    std::string fieldName(size_t f) const
+    {
+        return f < names.size() ? names[f] : "wgt_" + std::to_string(f - names.size());
+    }
+
+    // point the kept columns at `capacity` rows stored from `data` on
+    void attach(char* data, size_t capacity)
+    {
+        cols.assign(fields, Column{});
+        std::vector<size_t> at = placement();
+        size_t row = rowBytes();
+        for (size_t f = 0; f < fields; ++f) {
+            if (!kept(f)) continue;
+            if (layout == LAYOUT_ROWS) cols[f] = {data + at[f], row, fieldDtype(f)};
+            else                       cols[f] = {data + capacity * at[f], fieldSize(f), fieldDtype(f)};
+        }
+    }
+
+    // growable storage for at least `rows` rows; column-major layouts spread the columns out
+    // to their new capacity (last first, as every one of them moves up)
+    void grow(size_t rows)
+    {
+        size_t old = buf.capacity;
+        buf.reserve(rows, rowBytes());
+        if (layout != LAYOUT_ROWS && buf.capacity > old) {
+            std::vector<size_t> at = placement(), order = memoryOrder(at);
+            size_t cap = buf.capacity;
+            for (auto f = order.rbegin(); f != order.rend(); ++f)
+                std::memmove(buf.data + cap * at[*f], buf.data + old * at[*f], old * fieldSize(*f));
+        }
+        attach(buf.data, buf.capacity);
+    }
+
+    // column-major layouts: move the first `rows` rows of every column next to each other
+    void compact(size_t rows)
+    {
+        if (layout == LAYOUT_ROWS || rows >= buf.capacity) return;
+        std::vector<size_t> at = placement();
+        for (size_t f : memoryOrder(at))
+            std::memmove(buf.data + rows * at[f], buf.data + buf.capacity * at[f], rows * fieldSize(f));
+    }
+
+    // copy `rows` rows of `from` (same fields, dtype and selection) to the rows from `at` on
+    void copyRows(const OutputArray& from, size_t rows, size_t at) const
+    {
+        if (rows == 0) return;
+        for (size_t f = 0; f < fields; ++f) {
+            const Column& dst = cols[f];
+            const Column& src = from.cols[f];
+            if (!dst.base) continue;
+            size_t item = dtypeSize(dst.dtype);
+            if (dst.stride == item && src.stride == item)
+                std::memcpy(dst.base + at * item, src.base, rows * item);
+            else
+                for (size_t r = 0; r < rows; ++r)
+                    std::memcpy(dst.base + (at + r) * dst.stride, src.base + r * src.stride, item);
+        }
+    }
+
+    // numpy array (or dict of column arrays) over `rows` compact rows at `data`, kept
+    // alive by `owner`
+    py::object view(char* data, size_t rows, py::handle owner) const
+    {
+        auto item = static_cast<py::ssize_t>(itemSize());
+        auto r = static_cast<py::ssize_t>(rows), w = static_cast<py::ssize_t>(width());
+        if (layout == LAYOUT_ROWS)     return py::array(numpyDtype(dtype), {r, w}, {item * w, item}, data, owner);
+        if (layout == LAYOUT_COLUMNAR) return py::array(numpyDtype(dtype), {r, w}, {item, item * r}, data, owner);
+        py::dict d;
+        std::vector<size_t> at = placement();
+        for (size_t f = 0; f < fields; ++f)
+            if (kept(f)) {
+                auto size = static_cast<py::ssize_t>(fieldSize(f));
+                d[py::str(fieldName(f))] = py::array(numpyDtype(fieldDtype(f)), {r}, {size}, data + rows * at[f], owner);
+            }
+        return d;
+    }
+
+    // output of `rows` rows, with the columns pointing into it; not zeroed here, each row
+    // is cleared just before its event is stored (clearRows), so the pages are touched once,
+    // by the thread that fills them
+    py::object allocate(size_t rows)
+    {
+        auto item = static_cast<py::ssize_t>(itemSize());
+        auto r = static_cast<py::ssize_t>(rows), w = static_cast<py::ssize_t>(width());
+        // layout='dict' only hands out the columns: one block of bytes holds them all
+        py::array arr = layout == LAYOUT_ROWS ? py::array(numpyDtype(dtype), {r, w})
+                      : layout == LAYOUT_DICT ? py::array(py::dtype::of<uint8_t>(), {static_cast<py::ssize_t>(rows * rowBytes())})
+                                              : py::array(numpyDtype(dtype), {r, w}, {item, item * r});
+        attach(static_cast<char*>(arr.mutable_data()), rows);
+        if (layout != LAYOUT_DICT) return arr;
+        return view(static_cast<char*>(arr.mutable_data()), rows, arr);
+    }
+
+    // out=: the columns point into the caller's arrays instead, a 2-D array of at least
+    // `rows` rows (any strides, so C or Fortran order alike) or, with layout='dict', a dict of
+    // 1-D arrays by column name; returns a view of the first `rows` rows
+    py::object adopt(py::handle target, size_t rows, const std::string& what)
+    {
+        cols.assign(fields, Column{});
+        auto first = py::slice(0, static_cast<py::ssize_t>(rows), 1);
+        if (layout == LAYOUT_DICT) {
+            if (!py::isinstance<py::dict>(target))
+                throw std::invalid_argument("out= " + what + " must be a dict of 1-D arrays with layout='dict'");
+            auto given = py::reinterpret_borrow<py::dict>(target);
+            py::dict d;
+            for (size_t f = 0; f < fields; ++f) {
+                if (!kept(f)) continue;
+                std::string name = fieldName(f);
+                if (!given.contains(name)) throw std::invalid_argument("out= " + what + " has no column " + name);
+                py::array a = outputTarget(given[py::str(name)], 1, rows, fieldDtype(f), what + "[\"" + name + "\"]");
+                cols[f] = {static_cast<char*>(a.mutable_data()), static_cast<size_t>(a.strides(0)), fieldDtype(f)};
+                d[py::str(name)] = a[first];
+            }
+            return d;
+        }
+        py::array a = outputTarget(target, 2, rows, dtype, what);
+        if (a.shape(1) != static_cast<py::ssize_t>(width()))
+            throw std::invalid_argument("out= " + what + " has " + std::to_string(a.shape(1)) + " columns, expected "
+                                        + std::to_string(width()));
+        char* data = static_cast<char*>(a.mutable_data());
+        size_t j = 0;
+        for (size_t f = 0; f < fields; ++f)
+            if (kept(f)) cols[f] = {data + j++ * a.strides(1), static_cast<size_t>(a.strides(0)), fieldDtype(f)};
+        return a[first];
+    }
+
+    // zero rows [first, first + n) of the kept columns, before an event is stored in them:
+    // a value that does not parse, or a weight the event lacks, stays 0
+    void clearRows(size_t first, size_t n) const
+    {
+        for (const Column& c : cols) {
+            if (!c.base) continue;
+            size_t item = dtypeSize(c.dtype);
+            if (c.stride == item) std::memset(c.base + first * item, 0, n * item);
+            else
+                for (size_t r = first; r < first + n; ++r) std::memset(c.base + r * c.stride, 0, item);
+        }
+    }
+
+    // shrink the growable storage to the rows actually written and pass ownership to numpy
+    py::object release(size_t rows)
+    {
+        compact(rows);
+        if (rows < buf.capacity) {
+            char* p = static_cast<char*>(std::realloc(buf.data, std::max<size_t>(rows * rowBytes(), 1)));
+            if (p) buf.data = p;
+        }
+        py::object out = view(buf.data, rows, py::capsule(buf.data, [](void* q) { std::free(q); }));
+        buf.data     = nullptr;
+        buf.capacity = 0;
+        return out;
+    }
+};
+
+// <initrwgt> contents, collected without touching Python so the parse can run without
+// the GIL, and turned into the nested reweight dict (or the flat table) once it is done.
+// All of its text sits in one arena and the weights in one table, so files with
+// thousands of PDF member weights cost a few allocations rather than several per weight
+struct TextSpan
+{
+    uint32_t begin = 0, size = 0;  // in ReweightInfo::text
+};
+
+struct RwgtAttribute
+{
+    TextSpan key, value;
+};
+
+struct RwgtWeight
+{
+    int32_t  id         = 0;
+    uint32_t group      = 0;
+    uint32_t first_attr = 0, n_attrs = 0;  // in ReweightInfo::attributes, except id
+    TextSpan contents;
+};
+
+struct RwgtGroup
+{
+    TextSpan name;
+    TextSpan combine;
+    bool     has_combine = false;
+};
+
+struct ReweightInfo
+{
+    std::string                text;
+    std::vector<RwgtGroup>     groups;
+    std::vector<RwgtWeight>    weights;     // of a group one after the other, in file order
+    std::vector<RwgtAttribute> attributes;
+
+    TextSpan add(std::string_view v)
+    {
+        TextSpan span{static_cast<uint32_t>(text.size()), static_cast<uint32_t>(v.size())};
+        text.append(v);
+        return span;
+    }
+    std::string_view get(TextSpan span) const { return std::string_view(text).substr(span.begin, span.size); }
+    std::string      str(TextSpan span) const { return std::string(get(span)); }
+
+    // { group name: { "combine": str, weight id: { attribute: value, "contents": str } } }
+    py::dict toPython() const
+    {
+        std::vector<py::dict> group_dicts(groups.size());
+        for (size_t g = 0; g < groups.size(); ++g)
+            if (groups[g].has_combine) group_dicts[g]["combine"] = py::str(str(groups[g].combine));
+        for (const RwgtWeight& w : weights) {
+            // <weight id="3" MUR="0.5"  MUF="0.5"  DYN_SCALE="2"  PDF="247000" > MUR=0.5 MUF=0.5 dyn_scale_choice=HT  </weight>
+            py::dict d;
+            for (uint32_t a = w.first_attr; a < w.first_attr + w.n_attrs; ++a) {
+                std::string key = str(attributes[a].key), value = str(attributes[a].value);
+                if (key == "MUR" || key == "MUF")
+                    d[py::str(key)] = py::float_(std::atof(value.c_str()));
+                else if (key == "DYN_SCALE")
+                    d[py::str(key)] = py::int_(std::atoi(value.c_str()));
+                else
+                    d[py::str(key)] = py::str(value);
+            }
+            d[py::str("contents")] = py::str(str(w.contents));
+            group_dicts[w.group][py::int_(w.id)] = d; // convert id (key) to int
+        }
+        py::dict reweight;
+        for (size_t g = 0; g < groups.size(); ++g)
+            reweight[py::str(str(groups[g].name))] = group_dicts[g]; // a repeated name replaces the earlier group
+        return reweight;
+    }
+
+    // reweight='table': one entry per weight, { "id", "group" (index into "groups"), "MUR",
+    // "MUF" (nan if not given), "DYN_SCALE", "PDF" (-1 if not given): arrays, "contents":
+    // list } plus the group "groups" and "combine" lists
+    py::dict toTable() const
+    {
+        auto n = static_cast<py::ssize_t>(weights.size());
+        py::array_t<int32_t> id({n}), group({n}), dyn_scale({n});
+        py::array_t<double>  mur({n}), muf({n});
+        py::array_t<int64_t> pdf({n});
+        py::list contents;
+        for (size_t k = 0; k < weights.size(); ++k) {
+            const RwgtWeight& w = weights[k];
+            id.mutable_data()[k]        = w.id;
+            group.mutable_data()[k]     = static_cast<int32_t>(w.group);
+            mur.mutable_data()[k]       = std::numeric_limits<double>::quiet_NaN();
+            muf.mutable_data()[k]       = std::numeric_limits<double>::quiet_NaN();
+            dyn_scale.mutable_data()[k] = -1;
+            pdf.mutable_data()[k]       = -1;
+            for (uint32_t a = w.first_attr; a < w.first_attr + w.n_attrs; ++a) {
+                std::string key = str(attributes[a].key), value = str(attributes[a].value);
+                if      (key == "MUR")       mur.mutable_data()[k]       = std::atof(value.c_str());
+                else if (key == "MUF")       muf.mutable_data()[k]       = std::atof(value.c_str());
+                else if (key == "DYN_SCALE") dyn_scale.mutable_data()[k] = std::atoi(value.c_str());
+                else if (key == "PDF")       pdf.mutable_data()[k]       = std::atoll(value.c_str());
+            }
+            contents.append(py::str(str(w.contents)));
+        }
+        py::list names, combine;
+        for (const RwgtGroup& g : groups) {
+            names.append(py::str(str(g.name)));
+            combine.append(py::str(str(g.combine)));
+        }
+
+        py::dict table;
+        table["id"]        = id;
+        table["group"]     = group;
+        table["MUR"]       = mur;
+        table["MUF"]       = muf;
+        table["DYN_SCALE"] = dyn_scale;
+        table["PDF"]       = pdf;
+        table["contents"]  = contents;
+        table["groups"]    = names;
+        table["combine"]   = combine;
+        return table;
+    }
+
+    py::object toPython(bool table) const { return table ? py::object(toTable()) : py::object(toPython()); }
+};
+
+// <init>: the beams, their PDFs, the weighting strategy and one line per process
+struct InitInfo
+{
+    bool                 found     = false;  // the beam line parsed
+    int64_t              idbmup[2] = {0, 0};
+    double               ebmup[2]  = {0, 0};
+    int64_t              pdfgup[2] = {0, 0};
+    int64_t              pdfsup[2] = {0, 0};
+    int64_t              idwtup    = 0;
+    std::vector<double>  xsecup, xerrup, xmaxup;
+    std::vector<int64_t> lprup;
+
+    // { "IDBMUP": (2,), "EBMUP", "PDFGUP", "PDFSUP", "IDWTUP": int, "NPRUP": int,
+    //   "XSECUP": (NPRUP,), "XERRUP", "XMAXUP", "LPRUP" }
+    py::dict toPython() const
+    {
+        py::dict d;
+        d["IDBMUP"] = array(idbmup, 2);
+        d["EBMUP"]  = array(ebmup, 2);
+        d["PDFGUP"] = array(pdfgup, 2);
+        d["PDFSUP"] = array(pdfsup, 2);
+        d["IDWTUP"] = idwtup;
+        d["NPRUP"]  = static_cast<int64_t>(lprup.size());
+        d["XSECUP"] = array(xsecup.data(), xsecup.size());
+        d["XERRUP"] = array(xerrup.data(), xerrup.size());
+        d["XMAXUP"] = array(xmaxup.data(), xmaxup.size());
+        d["LPRUP"]  = array(lprup.data(), lprup.size());
+        return d;
+    }
+
+    template <typename T>
+    static py::array_t<T> array(const T* v, size_t n)
+    {
+        py::array_t<T> a({static_cast<py::ssize_t>(n)});
+        std::copy(v, v + n, a.mutable_data());
+        return a;
+    }
+};
+
+// parse_many: the <init> of all shards as one. The beams, PDFs and weighting strategy must
+// agree; processes are matched by LPRUP, their cross-sections combined weighted by
+// 1/XERRUP^2 (a plain mean if an error is 0) and XMAXUP is the largest
+static InitInfo mergeInit(const std::vector<InitInfo>& inits, const std::vector<std::string>& filenames)
+{
+    for (size_t f = 0; f < inits.size(); ++f)
+        if (!inits[f].found) throw std::runtime_error("Missing or malformed <init> in " + filenames[f]);
+
+    const InitInfo& first = inits[0];
+    for (size_t f = 1; f < inits.size(); ++f) {
+        const InitInfo& other = inits[f];
+        const char* field = nullptr;
+        for (int b = 0; b < 2 && !field; ++b) {
+            if      (other.idbmup[b] != first.idbmup[b]) field = "IDBMUP";
+            else if (other.ebmup[b]  != first.ebmup[b])  field = "EBMUP";
+            else if (other.pdfgup[b] != first.pdfgup[b]) field = "PDFGUP";
+            else if (other.pdfsup[b] != first.pdfsup[b]) field = "PDFSUP";
+        }
+        if (!field && other.idwtup != first.idwtup) field = "IDWTUP";
+        if (field)
+            throw std::runtime_error("<init> of " + filenames[f] + " does not match " + filenames[0] + ": " + field + " differs");
+    }
+
+    InitInfo merged = first;
+    merged.xsecup.clear();
+    merged.xerrup.clear();
+    merged.xmaxup.clear();
+    merged.lprup.clear();
+    for (const InitInfo& init : inits)
+        for (int64_t id : init.lprup)
+            if (std::find(merged.lprup.begin(), merged.lprup.end(), id) == merged.lprup.end()) merged.lprup.push_back(id);
+
+    for (int64_t id : merged.lprup) {
+        double sum = 0, sum_sq = 0, weighted = 0, inverse = 0, xmax = 0;
+        int    n = 0;
+        bool   all_errors = true;
+        for (const InitInfo& init : inits) {
+            auto it = std::find(init.lprup.begin(), init.lprup.end(), id);
+            if (it == init.lprup.end()) continue;
+            size_t p = it - init.lprup.begin();
+            double x = init.xsecup[p], e = init.xerrup[p];
+            sum    += x;
+            sum_sq += e * e;
+            if (e > 0) {
+                weighted += x / (e * e);
+                inverse  += 1 / (e * e);
+            } else {
+                all_errors = false;
+            }
+            xmax = n++ == 0 ? init.xmaxup[p] : std::max(xmax, init.xmaxup[p]);
+        }
+        merged.xsecup.push_back(all_errors ? weighted / inverse : sum / n);
+        merged.xerrup.push_back(all_errors ? 1 / std::sqrt(inverse) : std::sqrt(sum_sq) / n);
+        merged.xmaxup.push_back(xmax);
+    }
+    return merged;
+}
+
+// reweight option: the <initrwgt> as nested dicts or as the flat table
+static bool parseReweightTable(const std::string& name)
+{
+    if (name == "dict")  return false;
+    if (name == "table") return true;
+    throw std::invalid_argument("Unknown reweight '" + name + "', expected 'dict' or 'table'");
+}
+
+// extras=True: per-event values of an optional block (<scales> attributes, <mgrwt> entries),
+// one row per stored event; a column starts when its name is first seen, earlier rows
+// and events without it read nan
+struct ExtraTable
+{
+    std::vector<std::string>         names;
+    std::vector<std::vector<double>> cols;
+    std::vector<double>              pending;  // of the event being parsed
+    size_t                           rows = 0;
+    size_t                           hint = 0; // next column to try: names come in the same order
+
+    static double missing() { return std::numeric_limits<double>::quiet_NaN(); }
+
+    size_t column(std::string_view name)
+    {
+        for (size_t n = 0; n < names.size(); ++n) {
+            size_t c = (hint + n) % names.size();
+            if (names[c] == name) {
+                hint = c + 1;
+                return c;
+            }
+        }
+        names.emplace_back(name);
+        cols.emplace_back(rows, missing());
+        pending.push_back(missing());
+        return names.size() - 1;
+    }
+    void set(std::string_view name, double v) { pending[column(name)] = v; }
+
+    // </event> of a stored event, or of one rejected
+    void commit()
+    {
+        for (size_t c = 0; c < cols.size(); ++c) cols[c].push_back(pending[c]);
+        discard();
+        ++rows;
+    }
+    void discard() { std::fill(pending.begin(), pending.end(), missing()); }
+
+    // the rows of `other` after these
+    void append(const ExtraTable& other)
+    {
+        for (const std::string& name : other.names) column(name);
+        for (size_t c = 0; c < cols.size(); ++c) {
+            auto it = std::find(other.names.begin(), other.names.end(), names[c]);
+            if (it == other.names.end()) cols[c].resize(rows + other.rows, missing());
+            else {
+                const std::vector<double>& from = other.cols[it - other.names.begin()];
+                cols[c].insert(cols[c].end(), from.begin(), from.end());
+            }
+        }
+        rows += other.rows;
+    }
+
+    // iter_lhe: every chunk starts empty, the columns seen so far are kept
+    void clearRows()
+    {
+        for (std::vector<double>& c : cols) c.clear();
+        rows = 0;
+    }
+
+    py::dict toPython() const
+    {
+        py::dict d;
+        for (size_t c = 0; c < names.size(); ++c) {
+            py::array_t<double> a({static_cast<py::ssize_t>(rows)});
+            std::copy(cols[c].begin(), cols[c].end(), a.mutable_data());
+            d[py::str(names[c])] = a;
+        }
+        return d;
+    }
+};
+
+// comments=True: the '#' lines after the particles of an event (#aMCatNLO, #pdf, #rwgt, ...),
+// keyed by their first word. The text after it is kept for every stored event, in one buffer
+// with offsets; while each event has exactly one such line of the same count of numbers,
+// those numbers are kept as well and the tag is returned as a 2-D array instead
+struct CommentTable
+{
+    struct Tag
+    {
+        std::string           name;
+        std::string           text;         // of all rows, lines of one event joined by '\n'
+        std::vector<uint64_t> offsets{0};   // row r is text[offsets[r], offsets[r + 1])
+        std::vector<double>   values;       // rows x width, while regular
+        int64_t               width   = -1; // numbers per row, -1 before the first row
+        bool                  regular = true;
+
+        std::string           pending_text; // of the event being parsed
+        std::vector<double>   pending_values;
+        int                   pending_lines   = 0;
+        bool                  pending_numeric = true;
+
+        void commit()
+        {
+            text += pending_text;
+            offsets.push_back(text.size());
+            if (regular) {
+                int64_t n = static_cast<int64_t>(pending_values.size());
+                if (pending_lines == 1 && pending_numeric && (width < 0 || width == n)) {
+                    width = n;
+                    values.insert(values.end(), pending_values.begin(), pending_values.end());
+                } else {
+                    regular = false;
+                    std::vector<double>().swap(values);
+                }
+            }
+            discard();
+        }
+        void discard()
+        {
+            pending_text.clear();
+            pending_values.clear();
+            pending_lines   = 0;
+            pending_numeric = true;
+        }
+    };
+
+    std::vector<Tag> tags;
+    size_t           rows = 0;
+    size_t           hint = 0;
+
+    Tag& tag(std::string_view name)
+    {
+        for (size_t n = 0; n < tags.size(); ++n) {
+            size_t t = (hint + n) % tags.size();
+            if (tags[t].name == name) {
+                hint = t + 1;
+                return tags[t];
+            }
+        }
+        Tag& t = tags.emplace_back();
+        t.name = name;
+        t.offsets.assign(rows + 1, 0);
+        t.regular = rows == 0;          // the earlier events did not have it
+        return t;
+    }
+
+    // one '#' line of the event being parsed: its first word, and the rest of it; the
+    // caller tokenizes the numbers of the first line if the tag is still regular
+    Tag& add(std::string_view name, std::string_view rest)
+    {
+        Tag& t = tag(name);
+        if (t.pending_lines++ > 0) t.pending_text += '\n';
+        t.pending_text += rest;
+        return t;
+    }
+
+    void commit()
+    {
+        for (Tag& t : tags) t.commit();
+        ++rows;
+    }
+    void discard()
+    {
+        for (Tag& t : tags) t.discard();
+    }
+
+    void append(const CommentTable& other)
+    {
+        for (const Tag& from : other.tags) tag(from.name);
+        for (Tag& t : tags) {
+            auto it = std::find_if(other.tags.begin(), other.tags.end(), [&](const Tag& o) { return o.name == t.name; });
+            if (it == other.tags.end()) {
+                t.offsets.resize(rows + other.rows + 1, t.text.size());
+                if (other.rows > 0) t.regular = false;
+            } else {
+                const Tag& from = *it;
+                uint64_t base = t.text.size();
+                t.text += from.text;
+                for (size_t r = 1; r < from.offsets.size(); ++r) t.offsets.push_back(base + from.offsets[r]);
+                t.regular = t.regular && from.regular && (t.width < 0 || from.width < 0 || t.width == from.width);
+                if (t.regular) {
+                    t.values.insert(t.values.end(), from.values.begin(), from.values.end());
+                    if (t.width < 0) t.width = from.width;
+                } else {
+                    std::vector<double>().swap(t.values);
+                }
+            }
+        }
+        rows += other.rows;
+    }
+
+    void clearRows()
+    {
+        for (Tag& t : tags) {
+            t.text.clear();
+            t.offsets.assign(1, 0);
+            t.values.clear();
+            t.width   = -1;
+            t.regular = true;
+        }
+        rows = 0;
+    }
+
+    // { tag: 2-D array (rows, width) } when regular, else { tag: (bytes, offsets) }
+    py::dict toPython() const
+    {
+        py::dict d;
+        for (const Tag& t : tags) {
+            if (t.regular) {
+                py::ssize_t width = std::max<int64_t>(t.width, 0);
+                py::array_t<double> a({static_cast<py::ssize_t>(rows), width});
+                std::copy(t.values.begin(), t.values.end(), a.mutable_data());
+                d[py::str(t.name)] = a;
+            } else {
+                py::array_t<uint64_t> offsets({static_cast<py::ssize_t>(t.offsets.size())});
+                std::copy(t.offsets.begin(), t.offsets.end(), offsets.mutable_data());
+                d[py::str(t.name)] = py::make_tuple(py::bytes(t.text.data(), t.text.size()), offsets);
+            }
+        }
+        return d;
+    }
+};
+
+// extras=, comments=: which of the optional per-event data to collect
+enum ExtrasKind { EXTRAS_BLOCKS = 1, EXTRAS_COMMENTS = 2 };
+
+static int extrasKinds(bool extras, bool comments)
+{
+    return (extras ? EXTRAS_BLOCKS : 0) | (comments ? EXTRAS_COMMENTS : 0);
+}
+
+struct EventExtras
+{
+    ExtraTable   scales, mgrwt;
+    CommentTable comments;
+
+    void commit()  { scales.commit();  mgrwt.commit();  comments.commit(); }
+    void discard() { scales.discard(); mgrwt.discard(); comments.discard(); }
+    void append(const EventExtras& other)
+    {
+        scales.append(other.scales);
+        mgrwt.append(other.mgrwt);
+        comments.append(other.comments);
+    }
+    void clearRows()
+    {
+        scales.clearRows();
+        mgrwt.clearRows();
+        comments.clearRows();
+    }
+
+    // { "scales": { attribute: array }, "mgrwt": { entry: array } } and/or { "comments": ... },
+    // as asked for by `kinds`
+    py::dict toPython(int kinds) const
+    {
+        py::dict d;
+        if (kinds & EXTRAS_BLOCKS) {
+            d["scales"] = scales.toPython();
+            d["mgrwt"]  = mgrwt.toPython();
+        }
+        if (kinds & EXTRAS_COMMENTS) d["comments"] = comments.toPython();
+        return d;
+    }
+};
+
+// stats=True: counters and phase timers of a parse, read with the steady clock. Building
+// with -DQUICKLHE_NO_STATS compiles them out of the hot path (and stats=True then fails)
+#ifndef QUICKLHE_NO_STATS
+#define QUICKLHE_STATS 1
+#else
+#define QUICKLHE_STATS 0
+#endif
+
+using SteadyClock = std::chrono::steady_clock;
+
+static double secondsSince(SteadyClock::time_point t0)
+{
+    return std::chrono::duration<double>(SteadyClock::now() - t0).count();
+}
+
+struct ParseStats
+{
+    bool     enabled        = false;
+    uint64_t bytes          = 0;  // input read (decompressed)
+    double   count_seconds  = 0;  // pass 1
+    double   parse_seconds  = 0;  // expat or the fast scanner, event conversion included
+    double   event_seconds  = 0;  // processEvent() and <weights> lists; summed over threads
+    double   python_seconds = 0;  // allocating and handing out the arrays, building the result
+    int64_t  events         = 0;  // stored, as in the returned arrays
+    int64_t  particles      = 0;  // of the stored events
+    int64_t  weights        = 0;  // weight values of the stored events
+    int64_t  rejected       = 0;  // events select= left out
+    size_t   max_charbuf    = 0;  // largest text collected in charBuf
+
+    // counters of another state that parsed part of the same file
+    void add(const ParseStats& o)
+    {
+        bytes         += o.bytes;
+        event_seconds += o.event_seconds;
+        events        += o.events;
+        particles     += o.particles;
+        weights       += o.weights;
+        rejected      += o.rejected;
+        max_charbuf    = std::max(max_charbuf, o.max_charbuf);
+    }
+
+    py::dict toPython(double total_seconds) const
+    {
+        py::dict seconds;
+        seconds["count"]  = count_seconds;
+        seconds["xml"]    = std::max(parse_seconds - event_seconds, 0.0);
+        seconds["events"] = event_seconds;
+        seconds["python"] = python_seconds;
+        seconds["total"]  = total_seconds;
+        py::dict d;
+        d["bytes"]        = bytes;
+        d["seconds"]      = seconds;
+        d["events"]       = events;
+        d["particles"]    = particles;
+        d["weights"]      = weights;
+        d["rejected"]     = rejected;
+        d["max_charbuf"]  = max_charbuf;
+        d["mb_per_s"]     = total_seconds > 0 ? static_cast<double>(bytes) / 1e6 / total_seconds : 0.0;
+        d["events_per_s"] = total_seconds > 0 ? static_cast<double>(events) / total_seconds : 0.0;
+        return d;
+    }
+};
+
+// adds the wall time of its scope to `seconds` when stats are enabled; nothing without QUICKLHE_STATS
+class PhaseTimer
+{
+public:
+#if QUICKLHE_STATS
+    PhaseTimer(const ParseStats& stats, double& seconds) : seconds_(stats.enabled ? &seconds : nullptr)
+    {
+        if (seconds_) t0_ = SteadyClock::now();
+    }
+    ~PhaseTimer() { if (seconds_) *seconds_ += secondsSince(t0_); }
+
+private:
+    double*                 seconds_;
+    SteadyClock::time_point t0_;
+#else
+    PhaseTimer(const ParseStats&, double&) {}
+#endif
+};
+
+// sums=True: sum(w), sum(w^2) and the number of negative values of XWGTUP and of every
+// weight, over the events kept and per IDPRUP, gathered while parsing so normalising needs
+// no pass over f_evt (nor f_evt itself). The sums are compensated (Neumaier), so millions
+// of events and the partial sums of the threads add up without losing precision
+struct CompensatedSum
+{
+    double sum = 0, c = 0;
+
+    void add(double v)
+    {
+        double t = sum + v;
+        c += std::abs(sum) >= std::abs(v) ? (sum - t) + v : (v - t) + sum;
+        sum = t;
+    }
+    void add(const CompensatedSum& o)
+    {
+        add(o.sum);
+        add(o.c);
+    }
+    double value() const { return sum + c; }
+};
+
+// sums of one set of events; column 0 is XWGTUP, column 1 + i weight i
+struct WeightSums
+{
+    int64_t                     events = 0;
+    std::vector<CompensatedSum> sum, sum2;
+    std::vector<int64_t>        negative;
+
+    void widen(size_t columns)
+    {
+        if (sum.size() >= columns) return;
+        sum.resize(columns);
+        sum2.resize(columns);
+        negative.resize(columns);
+    }
+
+    void add(const std::vector<double>& w)
+    {
+        widen(w.size());
+        ++events;
+        for (size_t i = 0; i < w.size(); ++i) {
+            sum[i].add(w[i]);
+            sum2[i].add(w[i] * w[i]);
+            negative[i] += w[i] < 0;
+        }
+    }
+
+    void add(const WeightSums& o)
+    {
+        widen(o.sum.size());
+        events += o.events;
+        for (size_t i = 0; i < o.sum.size(); ++i) {
+            sum[i].add(o.sum[i]);
+            sum2[i].add(o.sum2[i]);
+            negative[i] += o.negative[i];
+        }
+    }
+
+    // {"events", "sum", "sum2", "negative", "negative_fraction"}, arrays of `columns`
+    py::dict toPython(size_t columns) const
+    {
+        auto n = static_cast<py::ssize_t>(columns);
+        py::array_t<double>  s1({n}), s2({n}), fraction({n});
+        py::array_t<int64_t> neg({n});
+        for (size_t i = 0; i < columns; ++i) {
+            bool seen = i < sum.size();
+            s1.mutable_data()[i]       = seen ? sum[i].value() : 0.0;
+            s2.mutable_data()[i]       = seen ? sum2[i].value() : 0.0;
+            neg.mutable_data()[i]      = seen ? negative[i] : 0;
+            fraction.mutable_data()[i] = events > 0 ? static_cast<double>(neg.mutable_data()[i]) / events : 0.0;
+        }
+        py::dict d;
+        d["events"]            = events;
+        d["sum"]               = s1;
+        d["sum2"]              = s2;
+        d["negative"]          = neg;
+        d["negative_fraction"] = fraction;
+        return d;
+    }
+};
+
+struct EventSums
+{
+    bool                    enabled = false;
+    WeightSums              total;
+    std::vector<int64_t>    process_ids;  // IDPRUP, in order of appearance
+    std::vector<WeightSums> processes;
+    size_t                  last = 0;     // of the previous event: events come in runs of one process
+
+    WeightSums& process(int64_t idprup)
+    {
+        if (last < process_ids.size() && process_ids[last] == idprup) return processes[last];
+        last = static_cast<size_t>(std::find(process_ids.begin(), process_ids.end(), idprup) - process_ids.begin());
+        if (last == process_ids.size()) {
+            process_ids.push_back(idprup);
+            processes.emplace_back();
+        }
+        return processes[last];
+    }
+
+    void add(int64_t idprup, const std::vector<double>& w)
+    {
+        total.add(w);
+        process(idprup).add(w);
+    }
+
+    // the sums of another state that parsed a later part of the same file
+    void add(const EventSums& o)
+    {
+        total.add(o.total);
+        for (size_t k = 0; k < o.process_ids.size(); ++k) process(o.process_ids[k]).add(o.processes[k]);
+    }
+
+    // the totals, with "columns" naming them, and "processes": {IDPRUP: sums}
+    py::dict toPython() const
+    {
+        size_t columns = total.sum.size();
+        py::list names;
+        for (size_t i = 0; i < columns; ++i) names.append(i == 0 ? std::string("XWGTUP") : "wgt_" + std::to_string(i - 1));
+        py::dict d = total.toPython(columns), by_process;
+        for (size_t k = 0; k < process_ids.size(); ++k) by_process[py::int_(process_ids[k])] = processes[k].toPython(columns);
+        d["columns"]   = names;
+        d["processes"] = by_process;
+        return d;
+    }
+};
+
+// what a parse of a whole file (or event range) returns: the <initrwgt> is kept as C++
+// data until the caller wants it in Python, so convert_lhe() can store it as well
+struct ParsedFile
+{
+    ReweightInfo reweight;
+    InitInfo     init;
+    py::object   i_evt, f_evt, i_ptc, f_ptc;
+    int64_t      n_events = 0;      // rows of i_evt / f_evt, also when columns= keeps none of them
+    int          extras_kinds = 0;  // EXTRAS_* collected, 0 for none
+    EventExtras  extras;
+    ParseStats   stats;             // stats=True
+    EventSums    sums;              // sums=True
+
+    // (reweight, i_evt, f_evt, i_ptc, f_ptc, [extras], [init])
+    py::tuple toTuple(bool table = false, bool with_init = false) const
+    {
+        py::list items;
+        items.append(reweight.toPython(table));
+        for (const py::object& a : {i_evt, f_evt, i_ptc, f_ptc}) items.append(a);
+        appendOptional(items, with_init);
+        return py::tuple(items);
+    }
+
+    // the items that follow the events: extras= / comments=, then init= (None without <init>)
+    void appendOptional(py::list& items, bool with_init) const
+    {
+        if (extras_kinds) items.append(extras.toPython(extras_kinds));
+        if (with_init) items.append(init.found ? py::object(init.toPython()) : py::object(py::none()));
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Event selection – select="..." is compiled once and tested on every event before it
+// takes any rows, e.g.  IDPRUP == 1 and XWGTUP > 0 and any(ISTUP == 1 and abs(IDUP) == 6)
+//
+//   event fields     NUP IDPRUP XWGTUP SCALUP AQEDUP AQCDUP
+//   particle fields  IDUP ISTUP MOTHUP1 MOTHUP2 ICOLUP1 ICOLUP2 PUP1..PUP5 VTIMUP SPINUP,
+//                    only inside any(...), all(...) or count(...) over the particles
+//   operators        or and not == != < <= > >= unary -, abs(x), parentheses
+// ---------------------------------------------------------------------------
+
+// an event as the selection sees it: parsed, but not stored yet
+struct EventValues
+{
+    double              header[6] = {};  // NUP IDPRUP XWGTUP SCALUP AQEDUP AQCDUP
+    int                 n_ptc     = 0;
+    std::vector<double> ptc;             // 13 per particle, IDUP ... SPINUP
+};
+
+class Selection
+{
+public:
+    explicit Selection(const std::string& text) : text_(text)
+    {
+        root_ = parseOr();
+        skipSpace();
+        if (pos_ != text_.size()) fail("unexpected '" + text_.substr(pos_, 1) + "'");
+    }
+
+    bool accept(const EventValues& ev) const { return eval(root_, ev, -1) != 0; }
+
+private:
+    enum Kind { CONST, EVENT_FIELD, PTC_FIELD, NEG, ABS, COUNT, ANY, ALL, NOT, AND, OR, EQ, NE, LT, LE, GT, GE };
+
+    struct Node
+    {
+        Kind   kind;
+        double value = 0;   // CONST
+        int    field = 0;   // EVENT_FIELD, PTC_FIELD
+        int    a = -1, b = -1;
+    };
+
+    double eval(int n, const EventValues& ev, int p) const
+    {
+        const Node& x = nodes_[n];
+        switch (x.kind) {
+            case CONST:       return x.value;
+            case EVENT_FIELD: return ev.header[x.field];
+            case PTC_FIELD:   return ev.ptc[13 * p + x.field];
+            case NEG:         return -eval(x.a, ev, p);
+            case ABS:         return std::fabs(eval(x.a, ev, p));
+            case COUNT: {
+                int count = 0;
+                for (int i = 0; i < ev.n_ptc; ++i) count += eval(x.a, ev, i) != 0;
+                return count;
+            }
+            case ANY:
+                for (int i = 0; i < ev.n_ptc; ++i)
+                    if (eval(x.a, ev, i) != 0) return 1;
+                return 0;
+            case ALL:
+                for (int i = 0; i < ev.n_ptc; ++i)
+                    if (eval(x.a, ev, i) == 0) return 0;
+                return 1;
+            case NOT: return eval(x.a, ev, p) == 0;
+            case AND: return eval(x.a, ev, p) != 0 && eval(x.b, ev, p) != 0;
+            case OR:  return eval(x.a, ev, p) != 0 || eval(x.b, ev, p) != 0;
+            case EQ:  return eval(x.a, ev, p) == eval(x.b, ev, p);
+            case NE:  return eval(x.a, ev, p) != eval(x.b, ev, p);
+            case LT:  return eval(x.a, ev, p) <  eval(x.b, ev, p);
+            case LE:  return eval(x.a, ev, p) <= eval(x.b, ev, p);
+            case GT:  return eval(x.a, ev, p) >  eval(x.b, ev, p);
+            case GE:  return eval(x.a, ev, p) >= eval(x.b, ev, p);
+        }
+        return 0;
+    }
+
+    // --- recursive descent over text_ ---
+    [[noreturn]] void fail(const std::string& what) const
+    {
+        throw std::invalid_argument("Invalid select expression at position " + std::to_string(pos_) + ": " + what);
+    }
+
+    int add(Kind kind, int a = -1, int b = -1)
+    {
+        Node x{kind};
+        x.a = a;
+        x.b = b;
+        nodes_.push_back(x);
+        return static_cast<int>(nodes_.size()) - 1;
+    }
+
+    void skipSpace()
+    {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) ++pos_;
+    }
+
+    // symbol or keyword at the current position (keywords must not run into a name)
+    bool take(std::string_view token)
+    {
+        skipSpace();
+        if (text_.compare(pos_, token.size(), token) != 0) return false;
+        size_t end = pos_ + token.size();
+        if (std::isalpha(static_cast<unsigned char>(token[0])) && end < text_.size()
+            && (std::isalnum(static_cast<unsigned char>(text_[end])) || text_[end] == '_'))
+            return false;
+        pos_ = end;
+        return true;
+    }
+
+    void expect(std::string_view token)
+    {
+        if (!take(token)) fail("expected '" + std::string(token) + "'");
+    }
+
+    int parseOr()
+    {
+        int n = parseAnd();
+        while (take("or") || take("||")) n = add(OR, n, parseAnd());
+        return n;
+    }
+
+    int parseAnd()
+    {
+        int n = parseNot();
+        while (take("and") || take("&&")) n = add(AND, n, parseNot());
+        return n;
+    }
+
+    int parseNot()
+    {
+        if (take("not") || (text_.compare(pos_, 2, "!=") != 0 && take("!"))) return add(NOT, parseNot());
+        return parseComparison();
+    }
+
+    int parseComparison()
+    {
+        static const std::pair<std::string_view, Kind> ops[] = {
+            {"==", EQ}, {"!=", NE}, {"<=", LE}, {">=", GE}, {"<", LT}, {">", GT}};
+        int n = parseUnary();
+        for (const auto& [token, kind] : ops)
+            if (take(token)) return add(kind, n, parseUnary());
+        return n;
+    }
+
+    int parseUnary()
+    {
+        if (take("-")) return add(NEG, parseUnary());
+        return parsePrimary();
+    }
+
+    int parsePrimary()
+    {
+        static const char* event_fields[]    = {"NUP", "IDPRUP", "XWGTUP", "SCALUP", "AQEDUP", "AQCDUP"};
+        static const char* particle_fields[] = {"IDUP", "ISTUP", "MOTHUP1", "MOTHUP2", "ICOLUP1", "ICOLUP2", "PUP1",
+                                                "PUP2", "PUP3", "PUP4", "PUP5", "VTIMUP", "SPINUP"};
+        if (take("(")) {
+            int n = parseOr();
+            expect(")");
+            return n;
+        }
+
+        skipSpace();
+        const char* begin = text_.c_str() + pos_;
+        double value;
+        auto [ptr, ec] = std::from_chars(begin, text_.c_str() + text_.size(), value);
+        if (ec == std::errc() && ptr > begin) {
+            pos_ += ptr - begin;
+            int n = add(CONST);
+            nodes_[n].value = value;
+            return n;
+        }
+
+        size_t end = pos_;
+        while (end < text_.size() && (std::isalnum(static_cast<unsigned char>(text_[end])) || text_[end] == '_')) ++end;
+        std::string name = text_.substr(pos_, end - pos_);
+        if (name.empty()) fail(pos_ < text_.size() ? "unexpected '" + text_.substr(pos_, 1) + "'" : "unexpected end");
+        pos_ = end;
+
+        for (int f = 0; f < 6; ++f)
+            if (name == event_fields[f]) {
+                int n = add(EVENT_FIELD);
+                nodes_[n].field = f;
+                return n;
+            }
+        for (int f = 0; f < 13; ++f)
+            if (name == particle_fields[f]) {
+                if (particle_depth_ == 0) fail(name + " is a particle field: use it inside any(), all() or count()");
+                int n = add(PTC_FIELD);
+                nodes_[n].field = f;
+                return n;
+            }
+
+        Kind kind;
+        if      (name == "abs")   kind = ABS;
+        else if (name == "any")   kind = ANY;
+        else if (name == "all")   kind = ALL;
+        else if (name == "count") kind = COUNT;
+        else fail("unknown name '" + name + "'");
+        if (kind != ABS && particle_depth_ > 0) fail(name + "() cannot be nested");
+
+        expect("(");
+        particle_depth_ += kind != ABS;
+        int arg = parseOr();
+        particle_depth_ -= kind != ABS;
+        expect(")");
+        return add(kind, arg);
+    }
+
+    std::string       text_;
+    size_t            pos_ = 0;
+    int               particle_depth_ = 0;
+    std::vector<Node> nodes_;
+    int               root_ = -1;
+};
+
+// columns= / weights= options: the fields and <weight> ids to keep, all when unset;
+// derived=: the kinematic f_ptc fields to compute, none when unset
+struct Projection
+{
+    bool                     all_columns = true;
+    std::vector<std::string> columns;
+    bool                     all_weights = true;
+    std::vector<std::string> weights;
+    std::vector<std::string> derived;
+};
+
+// f_ptc: the 7 floats of a particle, then the derived= fields pt, eta, phi, m
+static constexpr size_t N_PTC_FLOATS = 7;
+static constexpr size_t N_DERIVED    = 4;
+
+struct ParseState
+{
+    OutputArray ievt{DT_INT32, 2, {"NUP", "IDPRUP"}};                                            // i_evt
+    OutputArray fevt{DT_FLOAT64, 4, {"XWGTUP", "SCALUP", "AQEDUP", "AQCDUP"}};                      // f_evt, 4 + n_weights wide
+    OutputArray iptc{DT_INT32, 7, {"evt_idx", "IDUP", "ISTUP", "MOTHUP1", "MOTHUP2", "ICOLUP1", "ICOLUP2"}}; // i_ptc
+    OutputArray fptc{DT_FLOAT64, N_PTC_FLOATS + N_DERIVED,                                         // f_ptc
+                     {"PUP1", "PUP2", "PUP3", "PUP4", "PUP5", "VTIMUP", "SPINUP", "pt", "eta", "phi", "m"}};
+
+    ReweightInfo reweight;               // weights are added to the last group
+    InitInfo    init;
+    bool        in_rwgt_weight = false;  // inside a <weight> with an id
+
+    int         n_weights    = 0;
+    int         n_declared_weights = 0;  // <weight> entries seen in <initrwgt> (or <weightinfo>)
+    std::vector<std::string> weight_ids; // and their ids, "" when they have none
+    bool        weightinfo = false;      // declared by LHEF 2 <weightinfo> instead
+    Projection  projection;
+    bool        compact = false;         // compact=True, see configureOutputs()
+
+    // select=: events are tested before they take rows; a rejected one takes none, and its
+    // <wgt> are skipped
+    std::shared_ptr<const Selection> selection;
+    EventValues values;                  // the event being tested
+    bool        rejected   = false;
+    int64_t     n_rejected = 0;
+
+    // extras=True: <scales> and <mgrwt> of every stored event, comments=True: its '#' lines
+    int         want_extras = 0;         // EXTRAS_*
+    EventExtras extras;
+    bool        in_mgrwt    = false;
+    std::string mgrwt_entry;             // name of the <mgrwt> entry being captured
+    std::vector<double> mgrwt_values;
+    int64_t     n_events     = 0;        // rows available (exact count, or capacity when growable)
+    int64_t     n_particles  = 0;
+
+    // single-pass mode: arrays are grown while parsing instead of sized by countDimensions()
+    bool                   growable  = false;
+    XML_Parser             parser    = nullptr;
+    size_t                 file_size = 0;
+
+    // iter_lhe: events per chunk; expat is suspended once a chunk is full
+    int64_t                chunk_events  = 0;
+
+    // header scan (multi-threaded splitter, fast engine): stop at the first <event>
+    bool                   stop_at_event = false;
+    size_t                 body_begin    = std::string::npos;
+    std::string            body_head;     // streamed input already read past body_begin
+
+    // fast engine: file offset of the event being scanned, and an expat parser for
+    // the events it cannot handle itself (created on first use)
+    long long              scan_offset   = -1;
+    XML_Parser             fallback      = nullptr;
+
+    // mmap input: the bytes expat is parsing, indexed by XML_GetCurrentByteIndex, so event
+    // and <wgt> text is tokenized where it lies instead of being collected in charBuf
+    const char*            input_base    = nullptr;
+    long long              text_begin    = 0;
+
+    int64_t     cur_event    = 0;        // current row index
+    int         cur_weight   = 0;        // current column index (within event)
+    int         event_particles = 0;     // NUP of the current event, for stats
+    int64_t     cur_particle = 0;
+    int         capture      = NO_CAPTURE;
+
+    std::string charBuf;                 // accumulates character data
+    // streamed input: the text being captured while it is one run in expat's buffer,
+    // tokenized there; copied to charBuf (spilled) only once it straddles two input chunks
+    // or differs from the bytes it came from (entity and character references, \r\n)
+    std::string_view held;
+    bool        spilled    = false;
+    ReadOptions reading;                 // chunk_size=, prefetch=
+    const py::object* out = nullptr;     // out=: the caller's i_evt, f_evt, i_ptc, f_ptc
+    std::vector<double> momenta;         // derived=: PUP1..PUP4 of the event's particles
+    ParseStats  stats;                   // stats=True
+    EventSums   sums;                    // sums=True
+    int         ptc_decoder = -1;        // DECODE_*, chosen on the first event
+    std::vector<double> event_weights;   // sums=True: XWGTUP and the weights of the current event
+    int64_t     event_process = 0;       // sums=True: its IDPRUP
+
+    ParseState() = default;
+    ParseState(const ParseState&) = delete;
+    ParseState& operator=(const ParseState&) = delete;
+    ~ParseState() { if (fallback) XML_ParserFree(fallback); }
+};
+
+// layout, index_dtype and compact options. compact=True stores the floats as float32 and,
+// where each column can have its own dtype (layout='dict' and 'arrow'), the integers in
+// the narrowest type that holds their LHE range; evt_idx keeps index_dtype. A value that
+// does not fit (colour tags past 32767, mother indices of large showers) is an error
+static void configureOutputs(ParseState& s, int layout, int index_dtype, bool compact)
+{
+    for (OutputArray* a : {&s.ievt, &s.fevt, &s.iptc, &s.fptc})
+        a->layout = layout == LAYOUT_ARROW ? LAYOUT_DICT : layout;
+    s.iptc.dtype = index_dtype;
+    s.compact    = compact;
+    if (!compact) return;
+    s.fevt.dtype = s.fptc.dtype = DT_FLOAT32;
+    if (s.ievt.layout == LAYOUT_DICT) {
+        s.ievt.field_dtypes = {DT_INT16, DT_INT32};                                                 // NUP, IDPRUP
+        s.iptc.field_dtypes = {index_dtype, DT_INT32, DT_INT8, DT_INT16, DT_INT16, DT_INT16, DT_INT16}; // evt_idx, IDUP, ...
+    }
+}
+
+// columns= / weights= arguments: None, or a list of field names / weight ids (ints are
+// matched as the id text, so weights=[1, 2] and weights=["1", "2"] are the same);
+// derived=: None, or a list of "pt", "eta", "phi" and "m"
+static Projection parseProjection(const py::object& columns, const py::object& weights, const py::object& derived)
+{
+    Projection p;
+    p.all_columns = columns.is_none();
+    if (!p.all_columns)
+        for (py::handle c : columns) p.columns.push_back(py::str(c));
+    p.all_weights = weights.is_none();
+    if (!p.all_weights)
+        for (py::handle w : weights) p.weights.push_back(py::str(w));
+    if (!derived.is_none())
+        for (py::handle d : derived) {
+            std::string name = py::str(d);
+            if (name != "pt" && name != "eta" && name != "phi" && name != "m")
+                throw std::invalid_argument("Unknown derived quantity '" + name + "', expected 'pt', 'eta', 'phi' or 'm'");
+            p.derived.push_back(name);
+        }
+    return p;
+}
+
+// a column needed internally (evt_idx for layout='arrow'), kept unless all are
+static void keepColumn(Projection& p, const std::string& name)
+{
+    if (!p.all_columns && std::find(p.columns.begin(), p.columns.end(), name) == p.columns.end())
+        p.columns.push_back(name);
+}
+
+// columns= / weights=: select the fields each output keeps, once the <weight> ids (one per
+// weight column, in file order) are known; the kept columns stay in file order
+static void applyProjection(ParseState& s, const std::vector<std::string>& weight_ids)
+{
+    const Projection& p = s.projection;
+    s.fevt.fields = 4 + weight_ids.size();
+
+    std::vector<bool> found(p.columns.size(), false);
+    for (OutputArray* a : {&s.ievt, &s.fevt, &s.iptc, &s.fptc}) {
+        a->selected.assign(a->fields, true);
+        if (p.all_columns) continue;
+        for (size_t f = 0; f < a->names.size(); ++f) {
+            auto it = std::find(p.columns.begin(), p.columns.end(), a->names[f]);
+            a->selected[f] = it != p.columns.end();
+            if (a->selected[f]) found[it - p.columns.begin()] = true;
+        }
+    }
+    for (size_t i = 0; i < found.size(); ++i)
+        if (!found[i]) throw std::invalid_argument("Unknown column '" + p.columns[i] + "'");
+
+    // the derived fields after SPINUP are only computed when asked for, by derived= or columns=
+    for (size_t f = N_PTC_FLOATS; f < s.fptc.fields; ++f) {
+        bool asked = std::find(p.derived.begin(), p.derived.end(), s.fptc.names[f]) != p.derived.end();
+        s.fptc.selected[f] = asked || (!p.all_columns && s.fptc.selected[f]);
+    }
+
+    if (p.all_weights) return;
+    for (size_t w = 0; w < weight_ids.size(); ++w)
+        s.fevt.selected[4 + w] = std::find(p.weights.begin(), p.weights.end(), weight_ids[w]) != p.weights.end();
+    for (const std::string& id : p.weights)
+        if (std::find(weight_ids.begin(), weight_ids.end(), id) == weight_ids.end())
+            throw std::invalid_argument("Unknown weight id '" + id + "'");
+}
+
+// ---------------------------------------------------------------------------
+// Tokenizer – whitespace-separated numbers of the event and <wgt> text
+// ---------------------------------------------------------------------------
+static inline bool isDelim(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+// first delimiter (FindDelim) or first non-delimiter in [p, end), compared 16 bytes at a time
+// with SSE2 (x86-64) or NEON (aarch64), which both targets always have
+template <bool FindDelim>
+static inline const char* scanDelims(const char* p, const char* end)
+{
+    if (p < end && isDelim(*p) == FindDelim) return p;  // usual case when skipping a single space
+#if defined(__SSE2__)
+    const __m128i sp = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'), nl = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i d = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, cr)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(d));
+        if (!FindDelim) mask ^= 0xFFFF;
+        if (mask) return p + __builtin_ctz(mask);
+    }
+#elif defined(__ARM_NEON)
+    for (; end - p >= 16; p += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+        uint8x16_t d = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')), vceqq_u8(v, vdupq_n_u8('\t'))),
+                                vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')), vceqq_u8(v, vdupq_n_u8('\r'))));
+        if (!FindDelim) d = vmvnq_u8(d);
+        // 4 bits per byte: narrow the 0x00/0xFF lanes to a 64-bit mask
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(d), 4)), 0);
+        if (mask) return p + (__builtin_ctzll(mask) >> 2);
+    }
+#endif
+    while (p < end && isDelim(*p) != FindDelim) ++p;
+    return p;
+}
+
+// the powers of ten a double holds exactly
+static constexpr double EXACT_POW10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static inline bool isDigit(char c) { return static_cast<unsigned char>(c - '0') < 10; }
+
+// [+-]digits[.digits][(e|E)[+-]digits] spanning the whole token, as written by MadGraph and
+// Powheg (%+.10e and the like): with a mantissa below 2^53 and a power of ten of at most 22,
+// both are exact doubles and one multiplication or division rounds correctly, giving the same
+// value as from_chars (Clinger's fast path); anything else is left to from_chars
+static inline bool fastFloat(const char* p, const char* end, double& value)
+{
+    constexpr uint64_t MAX_MANTISSA = uint64_t(1) << 53;
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+
+    uint64_t m = 0;
+    int digits = 0, exp = 0;
+    for (; p < end && isDigit(*p); ++p, ++digits)
+        if ((m = m * 10 + (*p - '0')) > MAX_MANTISSA) return false;
+    if (p < end && *p == '.')
+        for (++p; p < end && isDigit(*p); ++p, ++digits, --exp)
+            if ((m = m * 10 + (*p - '0')) > MAX_MANTISSA) return false;
+    if (digits == 0) return false;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        bool eneg = false;
+        if (++p < end && (*p == '-' || *p == '+')) eneg = *p++ == '-';
+        const char* first = p;
+        int e = 0;
+        for (; p < end && isDigit(*p) && e < 1000; ++p) e = e * 10 + (*p - '0');
+        if (p == first) return false;
+        exp += eneg ? -e : e;
+    }
+    if (p != end || exp < -22 || exp > 22) return false;
+
+    double v = static_cast<double>(m);
+    v = exp < 0 ? v / EXACT_POW10[-exp] : v * EXACT_POW10[exp];
+    value = neg ? -v : v;
+    return true;
+}
+
+// -digits or digits spanning the whole token, without overflow
+static inline bool fastInt(const char* p, const char* end, int64_t& value)
+{
+    bool neg = p < end && *p == '-';
+    if (neg) ++p;
+    if (p == end || end - p > 18) return false;
+    int64_t v = 0;
+    for (; p < end; ++p) {
+        if (!isDigit(*p)) return false;
+        v = v * 10 + (*p - '0');
+    }
+    value = neg ? -v : v;
+    return true;
+}
+
+template <typename T>
+static inline bool parseToken(const char* p, const char* end, T& value)
+{
+    if constexpr (std::is_floating_point_v<T>) {
+        if (fastFloat(p, end, value)) return true;
+        if (*p == '+') ++p; // from_chars fails on a leading '+' for floating point values
+    } else {
+        int64_t v;
+        if (fastInt(p, end, v) && v >= std::numeric_limits<T>::min() && v <= std::numeric_limits<T>::max()) {
+            value = static_cast<T>(v);
+            return true;
+        }
+    }
+    // use from_chars to convert to int/double
+    return std::from_chars(p, end, value).ec == std::errc();
+}
+
+// helper to traverse charBuf and extract int/double values with no copy or string convert
+template <typename T>
+bool consume_next(std::string_view& sv, T& value) {
+    const char* end   = sv.data() + sv.size();
+    const char* begin = scanDelims<false>(sv.data(), end); // advance past leading whitespace
+    if (begin == end) return false; // exit if no non delim token
+    const char* stop  = scanDelims<true>(begin, end);     // end of token
+
+    bool ok = parseToken(begin, stop, value);
+    sv = std::string_view(stop, static_cast<size_t>(end - stop)); // point after this token
+    return ok;
+}
+
+// step over the next token without converting it (fields not kept by columns=)
+static void skip_next(std::string_view& sv)
+{
+    const char* end  = sv.data() + sv.size();
+    const char* stop = scanDelims<true>(scanDelims<false>(sv.data(), end), end);
+    sv = std::string_view(stop, static_cast<size_t>(end - stop));
+}
+
+// "<name>" or "<name attr=...>"
+static bool isTag(std::string_view sv, std::string_view name)
+{
+    return sv.size() > name.size() + 1 && sv[0] == '<' && sv.substr(1, name.size()) == name
+        && (sv[name.size() + 1] == '>' || sv[name.size() + 1] == '/'
+            || std::isspace(static_cast<unsigned char>(sv[name.size() + 1])));
+}
+
+// growable storage, at the first event: header (and <initrwgt>) is done, row widths are known
+static void setWeightColumns(ParseState* s)
+{
+    s->n_weights = s->n_declared_weights;
+    applyProjection(*s, s->weight_ids);
+}
+
+// make room for the current event and its n_ptc particles in the growable buffers
+static void growRows(ParseState* s, int n_ptc)
+{
+    if (!s->growable)
+        throw std::runtime_error("More events or particles than counted in pass 1 at event number: " + std::to_string(s->cur_event));
+
+    if (s->fevt.buf.capacity == 0) setWeightColumns(s);
+
+    size_t need_evt = s->cur_event + 1;
+    size_t need_ptc = s->cur_particle + n_ptc;
+    // iter_lhe: a chunk never holds more than chunk_events events
+    size_t init_evt = s->chunk_events > 0 ? static_cast<size_t>(s->chunk_events) : GROW_INIT_EVENTS;
+    size_t init_ptc = init_evt * (GROW_INIT_PARTICLES / GROW_INIT_EVENTS);
+
+    // once a representative sample has been read, extrapolate to the whole file
+    size_t est_evt = 0, est_ptc = 0;
+    long long consumed = s->scan_offset >= 0 ? s->scan_offset : s->parser ? XML_GetCurrentByteIndex(s->parser) : 0;
+    if (s->cur_event >= static_cast<int64_t>(GROW_INIT_EVENTS) && consumed > 0 && s->file_size > 0) {
+        double scale = 1.05 * static_cast<double>(s->file_size) / static_cast<double>(consumed);
+        est_evt = static_cast<size_t>(scale * s->cur_event);
+        est_ptc = static_cast<size_t>(scale * s->cur_particle);
+    }
+
+    // each buffer on its own: iter_lhe may have recycled some of them but not others
+    auto grow = [](OutputArray& a, size_t need, size_t init, size_t estimate) {
+        a.grow(need > a.buf.capacity ? std::max({need, 2 * a.buf.capacity, init, estimate}) : 0);
+    };
+    grow(s->ievt, need_evt, init_evt, est_evt);
+    grow(s->fevt, need_evt, init_evt, est_evt);
+    grow(s->iptc, need_ptc, init_ptc, est_ptc);
+    grow(s->fptc, need_ptc, init_ptc, est_ptc);
+
+    s->n_events    = static_cast<int64_t>(std::min(s->ievt.buf.capacity, s->fevt.buf.capacity));
+    s->n_particles = static_cast<int64_t>(std::min(s->iptc.buf.capacity, s->fptc.buf.capacity));
+}
+
+// rows for the event about to be stored and its n_ptc particles, cleared
+static void reserveRows(ParseState* s, int n_ptc)
+{
+    n_ptc = std::max(n_ptc, 0);
+    if (s->cur_event >= s->n_events || s->cur_particle + n_ptc > s->n_particles) growRows(s, n_ptc);
+    s->ievt.clearRows(s->cur_event, 1);
+    s->fevt.clearRows(s->cur_event, 1);
+    s->iptc.clearRows(s->cur_particle, n_ptc);
+    s->fptc.clearRows(s->cur_particle, n_ptc);
+}
+
+// derived=: any of the kinematic f_ptc fields kept
+static inline bool wantsKinematics(const Column* fp)
+{
+    return fp[7].base || fp[8].base || fp[9].base || fp[10].base;
+}
+
+// derived=: pt, eta, phi and m of the n particles from row `first` on, from their PUP1..PUP4
+// in p4 (the n px, then the n py, pz and E); one field at a time over the whole event, while
+// its momenta are still in cache. m is negative for a spacelike four-momentum, eta infinite
+// along the beam
+static void storeKinematics(const Column* fp, int64_t first, const double* p4, int n)
+{
+    const double* px = p4;
+    const double* py = p4 + n;
+    const double* pz = p4 + 2 * n;
+    const double* e  = p4 + 3 * n;
+    if (fp[7].base)
+        for (int p = 0; p < n; ++p) storeFloat(fp[7], first + p, std::sqrt(px[p] * px[p] + py[p] * py[p]));
+    if (fp[8].base)
+        for (int p = 0; p < n; ++p) {
+            double pt = std::sqrt(px[p] * px[p] + py[p] * py[p]);
+            double eta = pt > 0     ? std::asinh(pz[p] / pt)
+                       : pz[p] != 0 ? std::copysign(std::numeric_limits<double>::infinity(), pz[p]) : 0;
+            storeFloat(fp[8], first + p, eta);
+        }
+    if (fp[9].base)
+        for (int p = 0; p < n; ++p) storeFloat(fp[9], first + p, std::atan2(py[p], px[p]));
+    if (fp[10].base)
+        for (int p = 0; p < n; ++p) {
+            double m2 = e[p] * e[p] - (px[p] * px[p] + py[p] * py[p] + pz[p] * pz[p]);
+            storeFloat(fp[10], first + p, m2 >= 0 ? std::sqrt(m2) : -std::sqrt(-m2));
+        }
+}
+
+// sums=True: the event about to be stored is of process idprup with weight xwgtup; its
+// weights are filled in as they come, missing ones count as 0
+static void beginSums(ParseState* s, int64_t idprup, double xwgtup)
+{
+    s->event_weights.assign(1 + static_cast<size_t>(s->n_weights), 0.0);
+    s->event_weights[0] = xwgtup;
+    s->event_process    = idprup;
+}
+
+// select=: parse the whole event into s->values and test it; only an accepted event takes
+// rows, into which the kept fields are then copied
+static void processSelected(ParseState* s, std::string_view& sv, int n_ptc)
+{
+    EventValues& ev = s->values;
+    int64_t iv;
+    double  fv;
+    ev.header[0] = n_ptc;
+    ev.header[1] = consume_next(sv, iv) ? static_cast<double>(iv) : 0;
+    for (int i = 2; i < 6; ++i) ev.header[i] = consume_next(sv, fv) ? fv : 0;
+    ev.n_ptc = std::max(n_ptc, 0);
+    ev.ptc.resize(13 * static_cast<size_t>(ev.n_ptc));
+    for (double* v = ev.ptc.data(); v != ev.ptc.data() + ev.ptc.size(); v += 13) {
+        for (int i = 0; i < 6; ++i)  v[i] = consume_next(sv, iv) ? static_cast<double>(iv) : 0;
+        for (int i = 6; i < 13; ++i) v[i] = consume_next(sv, fv) ? fv : 0;
+    }
+
+    s->rejected = !s->selection->accept(ev);
+    if (s->rejected) return;
+
+    reserveRows(s, n_ptc);
+    if (s->sums.enabled) beginSums(s, static_cast<int64_t>(ev.header[1]), ev.header[2]);
+    int64_t evt = s->cur_event;
+    const Column* ie = s->ievt.cols.data();
+    const Column* fe = s->fevt.cols.data();
+    const Column* ip = s->iptc.cols.data();
+    const Column* fp = s->fptc.cols.data();
+    if (ie[0].base) storeInt(ie[0], evt, n_ptc);
+    if (ie[1].base) storeInt(ie[1], evt, static_cast<int64_t>(ev.header[1]));
+    for (int i = 0; i < 4; ++i)
+        if (fe[i].base) storeFloat(fe[i], evt, ev.header[2 + i]);
+    for (int p = 0; p < ev.n_ptc; ++p) {
+        const double* v = ev.ptc.data() + 13 * p;
+        int64_t ptc = s->cur_particle++;
+        if (ip[0].base) storeInt(ip[0], ptc, evt + 1);
+        for (int i = 1; i <= 6; ++i)
+            if (ip[i].base) storeInt(ip[i], ptc, static_cast<int64_t>(v[i - 1]));
+        for (int i = 0; i < 7; ++i)
+            if (fp[i].base) storeFloat(fp[i], ptc, v[6 + i]);
+    }
+    if (!wantsKinematics(fp)) return;
+    s->momenta.resize(4 * static_cast<size_t>(ev.n_ptc));
+    for (int p = 0; p < ev.n_ptc; ++p)
+        for (int i = 0; i < 4; ++i) s->momenta[i * ev.n_ptc + p] = ev.ptc[13 * p + 6 + i];
+    storeKinematics(fp, s->cur_particle - ev.n_ptc, s->momenta.data(), ev.n_ptc);
+}
+
+// comments=True: the '#' lines of the event text left after the particles
+static void processComments(ParseState* s, std::string_view sv)
+{
+    while (!sv.empty()) {
+        size_t eol = sv.find('\n');
+        std::string_view line = sv.substr(0, eol);
+        sv.remove_prefix(eol == std::string_view::npos ? sv.size() : eol + 1);
+
+        const char* end = line.data() + line.size();
+        const char* tag = scanDelims<false>(line.data(), end);
+        if (tag == end || *tag != '#') continue;
+        const char* tag_end = scanDelims<true>(tag, end);
+        const char* rest    = scanDelims<false>(tag_end, end);
+        while (end > rest && isDelim(end[-1])) --end;
+        std::string_view text(rest, static_cast<size_t>(end - rest));
+
+        CommentTable::Tag& t = s->extras.comments.add(std::string_view(tag, static_cast<size_t>(tag_end - tag)), text);
+        if (t.pending_lines > 1 || !t.regular) continue;
+        while (scanDelims<false>(text.data(), end) != end) {
+            double v;
+            if (!consume_next(text, v)) {
+                t.pending_numeric = false;
+                break;
+            }
+            t.pending_values.push_back(v);
+        }
+    }
+}
+
+// particle decoders: the generic one checks, per field, whether it is kept and which dtype
+// it is stored as; when all of IDUP..SPINUP are kept with one dtype per array and no
+// derived= fields (the usual case, whatever the generator) a specialisation of
+// decodeParticles<Int, Float> stores them straight, with no check per token
+static constexpr int DECODE_GENERIC = 0;
+static constexpr int DECODE_I32_F64 = 1;
+static constexpr int DECODE_I64_F64 = 2;
+static constexpr int DECODE_I32_F32 = 3;
+static constexpr int DECODE_I64_F32 = 4;
+
+static int particleDecoder(const ParseState* s)
+{
+    const Column* ip = s->iptc.cols.data();
+    const Column* fp = s->fptc.cols.data();
+    for (int i = 0; i < 7; ++i)
+        if (!ip[i].base || ip[i].dtype != ip[0].dtype || !fp[i].base || fp[i].dtype != fp[0].dtype)
+            return DECODE_GENERIC;
+    if (wantsKinematics(fp)) return DECODE_GENERIC;
+    bool wide = ip[0].dtype == DT_INT64;
+    if (!wide && ip[0].dtype != DT_INT32) return DECODE_GENERIC;
+    if (fp[0].dtype == DT_FLOAT64) return wide ? DECODE_I64_F64 : DECODE_I32_F64;
+    if (fp[0].dtype == DT_FLOAT32) return wide ? DECODE_I64_F32 : DECODE_I32_F32;
+    return DECODE_GENERIC;
+}
+
+template <typename T>
+static inline void storeAs(const Column& c, int64_t row, T v)
+{
+    *reinterpret_cast<T*>(c.base + row * c.stride) = v;
+}
+
+template <typename Int, typename Float>
+static void decodeParticles(ParseState* s, std::string_view& sv, int n_ptc, int64_t evt)
+{
+    const Column* ip = s->iptc.cols.data();
+    const Column* fp = s->fptc.cols.data();
+    int64_t iv;
+    double  fv;
+    for (int p = 0; p < n_ptc; p++) {
+        int64_t ptc = s->cur_particle++;
+        storeAs<Int>(ip[0], ptc, narrowed<Int>(evt + 1));
+        for (int i = 1; i <= 6; i++)  // fixed trip counts, unrolled by the compiler
+            if (consume_next(sv, iv)) storeAs<Int>(ip[i], ptc, narrowed<Int>(iv));
+        for (int i = 0; i < 7; ++i)
+            if (consume_next(sv, fv)) storeAs<Float>(fp[i], ptc, static_cast<Float>(fv));
+    }
+}
+
+static void decodeParticles(ParseState* s, std::string_view& sv, int n_ptc, int64_t evt)
+{
+    const Column* ip = s->iptc.cols.data();
+    const Column* fp = s->fptc.cols.data();
+    int64_t iv;
+    double  fv;
+    int64_t first_ptc = s->cur_particle;
+    double* p4 = nullptr; // derived=: PUP1..PUP4 are kept aside, see storeKinematics()
+    if (n_ptc > 0 && wantsKinematics(fp)) {
+        s->momenta.assign(4 * static_cast<size_t>(n_ptc), 0.0);
+        p4 = s->momenta.data();
+    }
+    for (int p = 0; p < n_ptc; p++) {
+        int64_t ptc = s->cur_particle;
+        if (ip[0].base) storeInt(ip[0], ptc, evt + 1); //event number is 1-indexed on user-facing side
+        // first 6 ints
+        for (int i = 1; i <= 6; i++) {
+            if (!ip[i].base) skip_next(sv);
+            else if (consume_next(sv, iv)) storeInt(ip[i], ptc, iv);
+        }
+        // remaining 7 doubles
+        for (int i = 0; i < 7; ++i) {
+            bool momentum = p4 && i < 4;
+            if (!fp[i].base && !momentum) skip_next(sv);
+            else if (consume_next(sv, fv)) {
+                if (fp[i].base) storeFloat(fp[i], ptc, fv);
+                if (momentum)   p4[i * n_ptc + p] = fv;
+            }
+        }
+        s->cur_particle++;
+    }
+    if (p4) storeKinematics(fp, first_ptc, p4, n_ptc);
+}
+
+//process header and particles from event and put them directly into struct
+void processEvent(ParseState* s, std::string_view sv)
+{    
+    // read headder (careful to save n_ptc for looping condation below)
+    PhaseTimer timer(s->stats, s->stats.event_seconds);
+    int n_ptc = 0; 
+    if (!consume_next(sv, n_ptc)) throw std::runtime_error("Failed to parse particle count from event number: " + std::to_string(s->cur_event));
+    s->event_particles = std::max(n_ptc, 0);
+    if (s->selection) {
+        processSelected(s, sv, n_ptc);
+        if ((s->want_extras & EXTRAS_COMMENTS) && !s->rejected) processComments(s, sv);
+        return;
+    }
+    reserveRows(s, n_ptc);
+
+    // values are stored only when they parse, a bad token leaves the zero in place;
+    // fields that are not kept (no base) are skipped without being converted
+    int64_t iv;
+    double  fv;
+    if (s->sums.enabled) { // IDPRUP and XWGTUP, whether kept or not
+        std::string_view head = sv;
+        int64_t idprup = consume_next(head, iv) ? iv : 0;
+        beginSums(s, idprup, consume_next(head, fv) ? fv : 0);
+    }
+    int64_t evt = s->cur_event;
+    const Column* ie = s->ievt.cols.data();
+    if (ie[0].base) storeInt(ie[0], evt, n_ptc);
+    if (!ie[1].base) skip_next(sv);
+    else if (consume_next(sv, iv)) storeInt(ie[1], evt, iv);
+
+    const Column* fe = s->fevt.cols.data();
+    for (int i = 0; i < 4; i++) { // read doubles
+        if (!fe[i].base) skip_next(sv);
+        else if (consume_next(sv, fv)) storeFloat(fe[i], evt, fv);
+    }
+
+    // read particles, with the decoder that fits the kept fields (chosen on the first event)
+    if (s->ptc_decoder < 0) s->ptc_decoder = particleDecoder(s);
+    switch (s->ptc_decoder) {
+        case DECODE_I32_F64: decodeParticles<int32_t, double>(s, sv, n_ptc, evt); break;
+        case DECODE_I64_F64: decodeParticles<int64_t, double>(s, sv, n_ptc, evt); break;
+        case DECODE_I32_F32: decodeParticles<int32_t, float>(s, sv, n_ptc, evt);  break;
+        case DECODE_I64_F32: decodeParticles<int64_t, float>(s, sv, n_ptc, evt);  break;
+        default:             decodeParticles(s, sv, n_ptc, evt);
+    }
+
+    // some files have additional metadata marked '#'
+    if (s->want_extras & EXTRAS_COMMENTS) processComments(s, sv);
+}
+
+static void processWeight(ParseState* s, std::string_view sv)
+{
+    if (s->rejected) return;
+    if (s->cur_weight < s->n_weights) { // more <wgt> than declared <weight> would spill into the next row
+        const Column& c = s->fevt.cols[4 + s->cur_weight];
+        double v;
+        if ((c.base || s->sums.enabled) && consume_next(sv, v)) {
+            if (c.base) storeFloat(c, s->cur_event, v);
+            if (s->sums.enabled) s->event_weights[1 + s->cur_weight] = v;
+        }
+        s->cur_weight++;
+    }
+}
+
+// <weights>: the weights of the event as one whitespace-separated list, in the order they
+// were declared (LHEF 2 <weightinfo>, or <weight>)
+static void processWeights(ParseState* s, std::string_view sv)
+{
+    if (s->rejected) return;
+    PhaseTimer timer(s->stats, s->stats.event_seconds);
+    const char* end = sv.data() + sv.size();
+    while (s->cur_weight < s->n_weights && scanDelims<false>(sv.data(), end) != end) {
+        const Column& c = s->fevt.cols[4 + s->cur_weight];
+        double v;
+        if (!c.base && !s->sums.enabled) skip_next(sv);
+        else if (consume_next(sv, v)) {
+            if (c.base) storeFloat(c, s->cur_event, v);
+            if (s->sums.enabled) s->event_weights[1 + s->cur_weight] = v;
+        }
+        s->cur_weight++;
+    }
+}
+
+// <scales muf="..." mur="..." pt_clust_3="...">: one extras column per numeric attribute
+static void processScale(ParseState* s, std::string_view name, std::string_view value)
+{
+    double v;
+    const char* begin = scanDelims<false>(value.data(), value.data() + value.size());
+    const char* end   = scanDelims<true>(begin, value.data() + value.size());
+    if (begin != end && parseToken(begin, end, v)) s->extras.scales.set(name, v);
+}
+
+// <mgrwt> entries (MG5 reweighting information): the numbers of <rscale>, <asrwt>,
+// <pdfrwt beam="b"> (as pdfrwt<b>) and <totfact>, as entry_0, entry_1, ... (one: entry)
+static void processMgrwt(ParseState* s, const std::string& entry, std::string_view sv)
+{
+    std::vector<double>& values = s->mgrwt_values;
+    values.clear();
+    const char* end = sv.data() + sv.size();
+    while (scanDelims<false>(sv.data(), end) != end) {
+        double v;
+        values.push_back(consume_next(sv, v) ? v : ExtraTable::missing());
+    }
+    if (values.size() == 1) s->extras.mgrwt.set(entry, values[0]);
+    else
+        for (size_t i = 0; i < values.size(); ++i) s->extras.mgrwt.set(entry + "_" + std::to_string(i), values[i]);
+}
+
+// <init>: IDBMUP1 IDBMUP2 EBMUP1 EBMUP2 PDFGUP1 PDFGUP2 PDFSUP1 PDFSUP2 IDWTUP NPRUP, then
+// XSECUP XERRUP XMAXUP LPRUP per process; what does not parse is left out, found says
+// whether the beam line did
+static void processInit(ParseState* s, std::string_view sv)
+{
+    InitInfo& init = s->init;
+    int64_t nprup = 0;
+    init.found = consume_next(sv, init.idbmup[0]) && consume_next(sv, init.idbmup[1])
+              && consume_next(sv, init.ebmup[0])  && consume_next(sv, init.ebmup[1])
+              && consume_next(sv, init.pdfgup[0]) && consume_next(sv, init.pdfgup[1])
+              && consume_next(sv, init.pdfsup[0]) && consume_next(sv, init.pdfsup[1])
+              && consume_next(sv, init.idwtup)    && consume_next(sv, nprup);
+    for (int64_t p = 0; init.found && p < nprup; ++p) {
+        double xsec, xerr, xmax;
+        int64_t id;
+        if (!(consume_next(sv, xsec) && consume_next(sv, xerr) && consume_next(sv, xmax) && consume_next(sv, id))) break;
+        init.xsecup.push_back(xsec);
+        init.xerrup.push_back(xerr);
+        init.xmaxup.push_back(xmax);
+        init.lprup.push_back(id);
+    }
+}
+
+// </event>: the row is complete, unless select= rejected the event; false if it did. Only
+// here is the event counted in stats, so one that is rejected is not counted
+static bool endEvent(ParseState* s)
+{
+    if (s->rejected) {
+        s->rejected = false;
+        s->n_rejected++;
+#if QUICKLHE_STATS
+        s->stats.rejected++;
+#endif
+        if (s->want_extras) s->extras.discard();
+        return false;
+    }
+    s->cur_event++;
+#if QUICKLHE_STATS
+    s->stats.events++;
+    s->stats.particles += s->event_particles;
+    s->stats.weights   += s->cur_weight;
+#endif
+    if (s->want_extras) s->extras.commit();
+    if (s->sums.enabled) s->sums.add(s->event_process, s->event_weights);
+    return true;
+}
+
+// text of the element being captured: straight from the mapped input when there is one
+// (from the end of its start tag up to the tag expat is at now), else what onChar collected
+static std::string_view capturedText(ParseState* s)
+{
+    if (!s->input_base) return s->spilled ? std::string_view(s->charBuf) : s->held;
+
+    long long end = XML_GetCurrentByteIndex(s->parser);
+    if (end <= s->text_begin) return {};  // empty element
+    std::string_view sv(s->input_base + s->text_begin, static_cast<size_t>(end - s->text_begin));
+    if (std::memchr(sv.data(), '<', sv.size()) == nullptr) return sv;
+
+    // comments / CDATA in between: keep only the character data, as onChar would
+    s->charBuf.clear();
+    while (!sv.empty()) {
+        size_t lt = sv.find('<');
+        s->charBuf.append(sv.substr(0, lt));
+        if (lt == std::string_view::npos) break;
+        sv.remove_prefix(lt);
+        bool cdata = startsWith(sv, "<![CDATA[");
+        std::string_view term = cdata ? "]]>" : startsWith(sv, "<!--") ? "-->" : ">";
+        size_t close = sv.find(term);
+        if (cdata) s->charBuf.append(sv.substr(9, close == std::string_view::npos ? close : close - 9));
+        sv.remove_prefix(close == std::string_view::npos ? sv.size() : close + term.size());
+    }
+    return s->charBuf;
+}
+
+// the held text is about to leave expat's buffer, or continues somewhere else: copy it
+static void spillCapture(ParseState* s)
+{
+    if (s->held.empty()) return;
+    s->charBuf.assign(s->held);
+    s->held    = {};
+    s->spilled = true;
+}
+
+// the captured text has been processed: drop it, wherever it is
+static void releaseCapture(ParseState* s)
+{
+    s->charBuf.clear();
+    s->held    = {};
+    s->spilled = false;
+}
+
+// start capturing the content of the element whose start tag expat just reported
+static void beginCapture(ParseState* s, int what)
+{
+    s->capture = what;
+    if (s->input_base)
+        s->text_begin = XML_GetCurrentByteIndex(s->parser) + XML_GetCurrentByteCount(s->parser);
+}
+
+// the elements the callbacks act on; every start and end tag is looked up once, by its
+// first letter and length, instead of being strcmp'ed against each name in turn
+static constexpr int TAG_OTHER       = 0;
+static constexpr int TAG_EVENT       = 1;
+static constexpr int TAG_WGT         = 2;
+static constexpr int TAG_WEIGHTS     = 3;
+static constexpr int TAG_WEIGHTINFO  = 4;
+static constexpr int TAG_WEIGHTGROUP = 5;
+static constexpr int TAG_WEIGHT      = 6;
+static constexpr int TAG_SCALES      = 7;
+static constexpr int TAG_MGRWT       = 8;
+static constexpr int TAG_INITRWGT    = 9;
+static constexpr int TAG_INIT        = 10;
+
+static int elementTag(const char* name)
+{
+    // the candidate is fixed by the switch, one compare confirms it
+    auto is = [name](const char* tag, int id) { return std::strcmp(name, tag) == 0 ? id : TAG_OTHER; };
+    switch (name[0]) {
+        case 'e': return is("event", TAG_EVENT);
+        case 's': return is("scales", TAG_SCALES);
+        case 'm': return is("mgrwt", TAG_MGRWT);
+        case 'i': return std::strlen(name) > 4 ? is("initrwgt", TAG_INITRWGT) : is("init", TAG_INIT);
+        case 'w':
+            switch (std::strlen(name)) {
+                case 3:  return is("wgt", TAG_WGT);
+                case 6:  return is("weight", TAG_WEIGHT);
+                case 7:  return is("weights", TAG_WEIGHTS);
+                case 10: return is("weightinfo", TAG_WEIGHTINFO);
+                case 11: return is("weightgroup", TAG_WEIGHTGROUP);
+            }
+            break;
+    }
+    return TAG_OTHER;
+}
+
+// -- SAX callbacks --
+
+static void XMLCALL onStart(void* ud, const XML_Char* name, const XML_Char** attributes)
+{
+    ParseState* s = static_cast<ParseState*>(ud);
+    int tag = elementTag(name);
+
+    if (tag == TAG_EVENT) {
+        if (s->stop_at_event) {
+            s->body_begin = static_cast<size_t>(XML_GetCurrentByteIndex(s->parser));
+            if (!s->input_base) {
+                // streamed input: keep what expat has buffered from this tag on, the source
+                // cannot be rewound (may start in an earlier block than the current one)
+                int offset = 0, size = 0;
+                const char* ctx = XML_GetInputContext(s->parser, &offset, &size);
+                if (!ctx) throw std::runtime_error("engine='fast' needs expat built with XML_CONTEXT_BYTES");
+                s->body_head.assign(ctx + offset, size - offset);
+            }
+            XML_StopParser(s->parser, XML_FALSE);
+            return;
+        }
+        beginCapture(s, EVENT_HEADER);
+        s->cur_weight = 0;
+    } else if (s->capture == EVENT_HEADER) {
+        // for header, next <tag> is equivalent to onEnd(...) because header has no enclosing tag
+        processEvent(s, capturedText(s));
+        // simularly, particle lines have no tag, so they must be processed without callbacks
+        releaseCapture(s); //end of event-level data (remainder has enclosing tags)
+        s->capture = NO_CAPTURE;
+    } else if (s->capture == INIT_BLOCK) { // <generator>, <weightinfo>, ... after the numbers
+        processInit(s, capturedText(s));
+        releaseCapture(s);
+        s->capture = NO_CAPTURE;
+    }
+
+    if (tag == TAG_WGT)
+        beginCapture(s, WGT_TAG);
+    else if (tag == TAG_WEIGHTS)
+        beginCapture(s, WGTS_BLOCK);
+    else if (tag == TAG_WEIGHTINFO && (s->n_declared_weights == 0 || s->weightinfo)) {
+        // LHEF 2 declaration of a <weights> entry, unless <initrwgt> declares the weights
+        s->weightinfo = true;
+        s->n_declared_weights++;
+        s->weight_ids.emplace_back();
+        for (int i = 0; attributes[i]; i += 2)
+            if (std::strcmp(attributes[i], "name") == 0) s->weight_ids.back() = attributes[i+1];
+    }
+    else if ((s->want_extras & EXTRAS_BLOCKS) && tag == TAG_SCALES) {
+        for (int i = 0; attributes[i]; i += 2) processScale(s, attributes[i], attributes[i+1]);
+    }
+    else if ((s->want_extras & EXTRAS_BLOCKS) && tag == TAG_MGRWT)
+        s->in_mgrwt = true;
+    else if (s->in_mgrwt) {
+        s->mgrwt_entry = name;
+        for (int i = 0; attributes[i]; i += 2)
+            if (std::strcmp(attributes[i], "beam") == 0) s->mgrwt_entry += attributes[i+1];
+        beginCapture(s, MGRWT_ENTRY);
+    }
+    else if (tag == TAG_INITRWGT)
+        s->capture = REWGT_BLOCK;
+    else if (tag == TAG_INIT)
+        beginCapture(s, INIT_BLOCK);
+    else if (s->capture == REWGT_BLOCK) {
+        ReweightInfo& rw = s->reweight;
+        if (tag == TAG_WEIGHTGROUP) {
+            const char *group_name = nullptr, *combine = nullptr;
+            for (int i = 0; attributes[i]; i += 2) {
+                if (std::strcmp(attributes[i], "name") == 0)         group_name = attributes[i+1];
+                else if (std::strcmp(attributes[i], "combine") == 0) combine    = attributes[i+1];
+            }
+            if (group_name) { // else weights stay in the previous group
+                RwgtGroup g;
+                g.name = rw.add(group_name);
+                if (combine) {
+                    g.combine     = rw.add(combine);
+                    g.has_combine = true;
+                }
+                rw.groups.push_back(g);
+            }
+        } else if (tag == TAG_WEIGHT) {
+            if (s->weightinfo) { // <initrwgt> after <weightinfo>s: its declarations replace theirs
+                s->n_declared_weights = 0;
+                s->weightinfo         = false;
+                s->weight_ids.clear();
+            }
+            s->n_declared_weights++; // used instead of pass 1 by single_pass and the header scan
+            s->weight_ids.emplace_back();
+            RwgtWeight w;
+            w.first_attr = static_cast<uint32_t>(rw.attributes.size());
+            size_t text_size = rw.text.size();
+            bool has_id = false;
+            for (int i = 0; attributes[i]; i += 2) {
+                if (std::strcmp(attributes[i], "id") == 0) {
+                    s->weight_ids.back() = attributes[i+1];
+                    w.id   = std::atoi(attributes[i+1]);
+                    has_id = true;
+                } else {
+                    rw.attributes.push_back({rw.add(attributes[i]), rw.add(attributes[i+1])});
+                }
+            }
+            if (has_id) {
+                if (rw.groups.empty()) rw.groups.emplace_back(); // outside any <weightgroup>
+                w.group   = static_cast<uint32_t>(rw.groups.size() - 1);
+                w.n_attrs = static_cast<uint32_t>(rw.attributes.size()) - w.first_attr;
+                rw.weights.push_back(w);
+            } else { // not kept: drop its attributes again
+                rw.attributes.resize(w.first_attr);
+                rw.text.resize(text_size);
+            }
+            s->in_rwgt_weight = has_id;
+        }
+    }
+}
+
+static void XMLCALL onEnd(void* ud, const XML_Char* name)
+{
+    ParseState* s = static_cast<ParseState*>(ud);
+    int tag = elementTag(name);
+
+    if (tag == TAG_EVENT) {
+        if (s->capture == EVENT_HEADER) { // event without any child element
+            processEvent(s, capturedText(s));
+            releaseCapture(s);
+            s->capture = NO_CAPTURE;
+        }
+        if (endEvent(s) && s->cur_event == s->chunk_events) // iter_lhe: chunk is full, resumed by the next call
+            XML_StopParser(s->parser, XML_TRUE);
+    }
+    else if (tag == TAG_WGT) {
+        processWeight(s, capturedText(s));
+        releaseCapture(s);
+        s->capture = NO_CAPTURE;
+    }
+    else if (s->capture == WGTS_BLOCK || s->capture == MGRWT_ENTRY) {
+        if (s->capture == WGTS_BLOCK) processWeights(s, capturedText(s));
+        else                          processMgrwt(s, s->mgrwt_entry, capturedText(s));
+        releaseCapture(s);
+        s->capture = NO_CAPTURE;
+    }
+    else if (tag == TAG_MGRWT)
+        s->in_mgrwt = false;
+    else if (s->capture == INIT_BLOCK) { // </init> without child elements
+        processInit(s, capturedText(s));
+        releaseCapture(s);
+        s->capture = NO_CAPTURE;
+    }
+    else if (tag == TAG_INITRWGT)
+        s->capture = NO_CAPTURE;
+    else if (tag == TAG_WEIGHT && s->capture == REWGT_BLOCK) {
+        if (s->in_rwgt_weight) s->reweight.weights.back().contents = s->reweight.add(s->charBuf);
+        s->in_rwgt_weight = false;
+        s->charBuf.clear();
+    }
+}
+
+// where in expat's buffer the character data being reported lies, null when it is not a
+// copy of those bytes. Expat passes data runs in place but every newline from a local
+// (normalised, "\r\n" too), and references from elsewhere; a '\n' that stands for a '\n'
+// still counts as the buffer's. Needs XML_CONTEXT_BYTES, else the text is always spilled
+static const char* bufferedText(ParseState* s, const XML_Char* buf, int len)
+{
+    int offset = 0, size = 0;
+    const char* ctx = XML_GetInputContext(s->parser, &offset, &size);
+    if (!ctx || offset < 0 || len > size - offset) return nullptr;
+    const char* at = ctx + offset;
+    if (at == buf) return at;
+    return len == 1 && *buf == '\n' && *at == '\n' ? at : nullptr;
+}
+
+static void XMLCALL onChar(void* ud, const XML_Char* buf, int len)
+{
+    auto* s = static_cast<ParseState*>(ud);
+    // with mmap input only the <initrwgt> text still needs collecting
+    if (s->capture != REWGT_BLOCK && (!s->capture || s->input_base)) return;
+    if (s->capture != REWGT_BLOCK && !s->spilled) {
+        const char* at = bufferedText(s, buf, len);
+        if (at && (s->held.empty() || at == s->held.data() + s->held.size())) {
+            s->held = std::string_view(s->held.empty() ? at : s->held.data(), s->held.size() + len);
+            return;
+        }
+        spillCapture(s);
+        s->spilled = true; // also when nothing was held yet, the text starts in charBuf
+    }
+    s->charBuf.append(buf, len);
+#if QUICKLHE_STATS
+    s->stats.max_charbuf = std::max(s->stats.max_charbuf, s->charBuf.size());
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Driving expat over (a range of) the file
+// ---------------------------------------------------------------------------
+static XML_Parser createParser(ParseState* s)
+{
+    XML_Parser parser = XML_ParserCreate(nullptr);
+    XML_SetUserData(parser, s);
+    XML_SetElementHandler(parser, onStart, onEnd);
+    XML_SetCharacterDataHandler(parser, onChar);
+    s->parser = parser;
+    return parser;
+}
+
+static std::string expatError(XML_Parser parser)
+{
+    return std::string("Expat error at line ")
+         + std::to_string(XML_GetCurrentLineNumber(parser))
+         + ": "
+         + XML_ErrorString(XML_GetErrorCode(parser));
+}
+
+// the state a parser reports to, none for a bare parser (benchmark_lhe)
+static ParseState* parserState(XML_Parser parser)
+{
+    return static_cast<ParseState*>(XML_GetUserData(parser));
+}
+
+// feeds the source to the parser, with isFinal at its end when `final` is set; a parse
+// stopped from a callback (XML_StopParser) is not an error. The source is read straight
+// into expat's buffer, chunk_size bytes at a time
+static void runParser(XML_Parser parser, ByteSource& src, bool final)
+{
+    ParseState* s = parserState(parser);
+    size_t chunk = s ? s->reading.chunk_size : CHUNK;
+    while (true)
+    {
+        if (s) spillCapture(s); // expat may move its buffer for the next chunk
+        void* buf = XML_GetBuffer(parser, static_cast<int>(chunk));
+        if (!buf) throw std::bad_alloc();
+        size_t got  = src.read(static_cast<char*>(buf), chunk);
+        int isFinal = final && got == 0 ? 1 : 0;
+
+        if (XML_ParseBuffer(parser, static_cast<int>(got), isFinal) == XML_STATUS_ERROR)
+        {
+            if (XML_GetErrorCode(parser) == XML_ERROR_ABORTED) return;
+            throw std::runtime_error(expatError(parser));
+        }
+
+        if (got == 0) break;
+    }
+}
+
+// same for input that is already in memory: no chunk copy, expat parses straight from
+// the mapping (and only buffers a token cut at a piece boundary)
+static void runParser(XML_Parser parser, std::string_view data, bool final)
+{
+    constexpr size_t PIECE = size_t(1) << 30; // XML_Parse takes an int length
+    ParseState* s = parserState(parser);
+    do {
+        size_t bytes = std::min(PIECE, data.size());
+        int isFinal  = final && bytes == data.size() ? 1 : 0;
+        if (s) spillCapture(s);
+        if (XML_Parse(parser, data.data(), static_cast<int>(bytes), isFinal) == XML_STATUS_ERROR) {
+            if (XML_GetErrorCode(parser) == XML_ERROR_ABORTED) return;
+            throw std::runtime_error(expatError(parser));
+        }
+        data.remove_prefix(bytes);
+    } while (!data.empty());
+}
+
+// ---------------------------------------------------------------------------
+// Fast engine – hand-written scanner for the <event> body
+// once the header is parsed by expat, events are located with memchr/find and their
+// text is tokenized in place; anything beyond the usual tags goes to expat instead
+// ---------------------------------------------------------------------------
+static constexpr int ENGINE_EXPAT = 0;
+static constexpr int ENGINE_FAST  = 1;
+
+static int parseEngine(const std::string& name)
+{
+    if (name == "expat") return ENGINE_EXPAT;
+    if (name == "fast")  return ENGINE_FAST;
+    throw std::invalid_argument("Unknown engine '" + name + "', expected 'expat' or 'fast'");
+}
+
+// hand an element (or any run of content) to expat, as if it appeared inside <LesHouchesEvents>
+static void parseWithExpat(ParseState* s, std::string_view sv)
+{
+    if (!s->fallback) {
+        static const char root[] = "<LesHouchesEvents>";
+        s->fallback = XML_ParserCreate(nullptr);
+        XML_SetUserData(s->fallback, s);
+        XML_SetElementHandler(s->fallback, onStart, onEnd);
+        XML_SetCharacterDataHandler(s->fallback, onChar);
+        XML_Parse(s->fallback, root, sizeof(root) - 1, 0);
+    }
+    // byte indices of the fallback parser do not point into the input
+    const char* input_base = s->input_base;
+    XML_Parser  parser     = s->parser;
+    s->input_base = nullptr;
+    s->parser     = s->fallback;
+    spillCapture(s);
+    bool ok = XML_Parse(s->fallback, sv.data(), static_cast<int>(sv.size()), 0) != XML_STATUS_ERROR;
+    s->input_base = input_base;
+    s->parser     = parser;
+    if (!ok)
+        throw std::runtime_error(std::string("Expat error in event number ")
+                                 + std::to_string(s->cur_event) + ": "
+                                 + XML_ErrorString(XML_GetErrorCode(s->fallback)));
+}
+
+// fn(name, value) for each attribute of `tag` ("<name a="1" b='2'"), values as written
+template <typename F>
+static void forEachAttribute(std::string_view tag, F fn)
+{
+    size_t pos = tag.find_first_of(" \t\r\n");
+    while (pos != std::string_view::npos) {
+        size_t name = tag.find_first_not_of(" \t\r\n", pos);
+        if (name == std::string_view::npos) return;
+        size_t eq = tag.find('=', name);
+        if (eq == std::string_view::npos) return;
+        size_t q = tag.find_first_of("\"'", eq);
+        if (q == std::string_view::npos) return;
+        size_t close = tag.find(tag[q], q + 1);
+        if (close == std::string_view::npos) return;
+        std::string_view key = tag.substr(name, eq - name);
+        fn(key.substr(0, key.find_last_not_of(" \t\r\n") + 1), tag.substr(q + 1, close - q - 1));
+        pos = close + 1;
+    }
+}
+
+// the entries of an <mgrwt> block, as the SAX callbacks collect them; only checked
+// without `commit`
+static bool decodeMgrwt(ParseState* s, std::string_view block, bool commit)
+{
+    if (block.find_first_of("&!") != std::string_view::npos) return false; // entities, comments
+    for (size_t lt = block.find('<'); lt != std::string_view::npos; lt = block.find('<', lt + 1)) {
+        if (block.substr(lt, 2) == "</") continue;
+        size_t gt = block.find('>', lt);
+        if (gt == std::string_view::npos) return false;
+        std::string_view tag = block.substr(lt, gt - lt);
+        if (tag.back() == '/') continue;
+        size_t name_end = std::min(tag.find_first_of(" \t\r\n/"), tag.size());
+        s->mgrwt_entry.assign(tag.substr(1, name_end - 1));
+        forEachAttribute(tag, [s](std::string_view key, std::string_view value) {
+            if (key == "beam") s->mgrwt_entry.append(value);
+        });
+        size_t end = block.find('<', gt);
+        if (commit) processMgrwt(s, s->mgrwt_entry, block.substr(gt + 1, end - gt - 1));
+        lt = end == std::string_view::npos ? block.size() : end;
+        if (lt == block.size()) break;
+    }
+    return true;
+}
+
+// the elements of an event after its text, from the first '<' to </event>: only checked
+// without `commit`, stored with it; false if anything is beyond the scanner
+static bool decodeEventBody(ParseState* s, std::string_view ev, bool commit)
+{
+    size_t gt, lt;
+    std::string_view text;
+    for (; !startsWith(ev, "</event>"); ev.remove_prefix(ev.find('<', 1))) {
+        if (isTag(ev, "wgt")) {
+            gt = ev.find('>');
+            lt = ev.find('<', gt);
+            text = ev.substr(gt + 1, lt - gt - 1);
+            if (!startsWith(ev.substr(lt), "</wgt>") || text.find('&') != std::string_view::npos) return false;
+            if (commit) processWeight(s, text);
+            ev.remove_prefix(lt);  // continue at </wgt>
+        } else if (isTag(ev, "weights")) {
+            gt = ev.find('>');
+            size_t close = ev.find("</weights>");
+            if (close == std::string_view::npos || ev[gt - 1] == '/') return false;
+            text = ev.substr(gt + 1, close - gt - 1);
+            if (text.find_first_of("<&") != std::string_view::npos) return false;
+            if (commit) processWeights(s, text);
+            ev.remove_prefix(close);
+        } else if (isTag(ev, "rwgt") || startsWith(ev, "</rwgt>") || startsWith(ev, "</wgt>")) {
+            continue;
+        } else if (isTag(ev, "mgrwt") || isTag(ev, "scales")) {
+            gt = ev.find('>');
+            bool mgrwt = ev[1] == 'm';
+            bool blocks = s->want_extras & EXTRAS_BLOCKS;
+            if (blocks && !mgrwt) {
+                std::string_view tag = ev.substr(0, gt);
+                if (tag.find('&') != std::string_view::npos) return false;
+                if (commit)
+                    forEachAttribute(tag, [s](std::string_view name, std::string_view value) {
+                        processScale(s, name, value);
+                    });
+            }
+            if (ev[gt - 1] == '/') continue;
+            size_t close = ev.find(mgrwt ? "</mgrwt>" : "</scales>");
+            if (close == std::string_view::npos) return false;
+            if (blocks && mgrwt && !decodeMgrwt(s, ev.substr(gt + 1, close - gt - 1), commit)) return false;
+            ev.remove_prefix(close);
+        } else if (startsWith(ev, "<!--")) {
+            size_t close = ev.find("-->");
+            if (close == std::string_view::npos) return false;
+            ev.remove_prefix(close);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// decode one complete <event>...</event> span; false if it contains anything the scanner
+// does not handle (entities, CDATA, unknown tags). The whole span is checked before the
+// event touches the rows, sums or stats, so on false nothing is committed
+static bool decodeEvent(ParseState* s, std::string_view ev)
+{
+    size_t gt = ev.find('>');
+    size_t lt = ev.find('<', gt);
+    std::string_view text = ev.substr(gt + 1, lt - gt - 1);
+    if (text.find('&') != std::string_view::npos || startsWith(ev.substr(lt), "<!--")) return false;
+    if (!decodeEventBody(s, ev.substr(lt), false)) return false;
+
+    s->cur_weight = 0;
+    processEvent(s, text);
+    decodeEventBody(s, ev.substr(lt), true);
+    endEvent(s);
+    return true;
+}
+
+// scan complete events in buf, whose first byte is at file offset `offset`; returns the
+// number of bytes consumed (an incomplete trailing event is left for the next call unless
+// `final`) and sets `done` at </LesHouchesEvents>
+static size_t scanEvents(ParseState* s, std::string_view buf, size_t offset, bool final, bool& done)
+{
+    size_t p = 0;
+    while (true) {
+        size_t lt = buf.find('<', p);
+        if (lt == std::string_view::npos) return buf.size();  // whitespace between events
+        std::string_view rest = buf.substr(lt);
+
+        if (!final && rest.size() < 32) return lt;             // too short to classify
+        if (startsWith(rest, "</LesHouchesEvents")) { done = true; return lt; }
+
+        if (isTag(rest, "event")) {
+            size_t close = rest.find("</event>");
+            if (close == std::string_view::npos) {
+                if (final) throw std::runtime_error("Unterminated <event> at byte " + std::to_string(offset + lt));
+                return lt;
+            }
+            std::string_view ev = rest.substr(0, close + 8);
+            s->scan_offset = static_cast<long long>(offset + lt);
+            if (!decodeEvent(s, ev)) parseWithExpat(s, ev); // nothing stored yet: expat does the event
+            p = lt + ev.size();
+        } else if (startsWith(rest, "<!--")) {
+            size_t close = rest.find("-->");
+            if (close == std::string_view::npos) {
+                if (final) throw std::runtime_error("Unterminated comment at byte " + std::to_string(offset + lt));
+                return lt;
+            }
+            p = lt + close + 3;
+        } else {
+            // not an event: everything up to the next one goes to expat
+            size_t next = findEventTag(rest, 1);
+            if (next == std::string_view::npos) {
+                if (!final) return lt;
+                next = rest.size();
+            }
+            parseWithExpat(s, rest.substr(0, next));
+            p = lt + next;
+        }
+    }
+}
+
+// fast engine over a source whose first byte is at file offset `offset`, continuing after the
+// already read `rest`; blocks are scanned in place and only an event cut by a block boundary
+// is copied
+static void runScanner(ParseState* s, ByteSource& src, size_t offset, std::string rest = {})
+{
+    bool done = false;
+    while (!done) {
+        std::string_view block = src.next();
+        bool final = block.empty();
+        std::string_view data = block;
+        if (!rest.empty() || final) {
+            rest.append(block);
+            data = rest;
+        }
+
+        size_t used = scanEvents(s, data, offset, final, done);
+        offset += used;
+        if (final) break;
+        if (data.data() == block.data()) rest.assign(block.substr(used));
+        else rest.erase(0, used);
+    }
+}
+
+// fast engine over a mapped range starting at file offset `offset`: tokenized in place
+static void runScanner(ParseState* s, std::string_view data, size_t offset)
+{
+    bool done = false;
+    scanEvents(s, data, offset, true, done);
+}
+
+// parse a whole file (the mapping when there is one) into state; the fast engine leaves
+// expat at the first <event> and scans the body itself
+static void runFile(ParseState& state, const std::string& filename, const InputInfo& input, const MappedFile* map,
+                    int engine)
+{
+    PhaseTimer timer(state.stats, state.stats.parse_seconds);
+    std::string_view data;
+    std::unique_ptr<ByteSource> src;
+    if (map) data = map->view();
+    else {
+        src = openSource(filename, input, state.reading);
+        src->setBlockSize(state.reading.chunk_size);
+    }
+    if (state.stats.enabled) {
+        if (map) state.stats.bytes += data.size();
+        else     src = std::make_unique<CountingSource>(std::move(src), state.stats.bytes);
+    }
+
+    state.stop_at_event = engine == ENGINE_FAST;
+    state.input_base    = map ? data.data() : nullptr;
+    XML_Parser parser = createParser(&state);
+    try {
+        if (map) runParser(parser, data, true);
+        else     runParser(parser, *src, true);
+    } catch (...) { XML_ParserFree(parser); throw; }
+    XML_ParserFree(parser);
+    state.parser = nullptr;
+
+    if (state.stop_at_event && state.body_begin != std::string::npos) {
+        state.stop_at_event = false;
+        if (map) runScanner(&state, data.substr(state.body_begin), state.body_begin);
+        else     runScanner(&state, *src, state.body_begin, std::move(state.body_head));
+    }
+}
+
+// allocate the four output arrays from pass 1 counts (one weight column per id) and point
+// the state at them
+static void allocateArrays(ParseState& state, int64_t n_events, const std::vector<std::string>& weight_ids,
+                           int64_t n_particles, py::object& i_evt, py::object& f_evt, py::object& i_ptc,
+                           py::object& f_ptc)
+{
+    PhaseTimer timer(state.stats, state.stats.python_seconds);
+    int n_weights = static_cast<int>(weight_ids.size());
+    applyProjection(state, weight_ids);
+    if (state.out) {
+        i_evt = state.ievt.adopt(state.out[0], n_events, "i_evt");
+        f_evt = state.fevt.adopt(state.out[1], n_events, "f_evt");
+        i_ptc = state.iptc.adopt(state.out[2], n_particles, "i_ptc");
+        f_ptc = state.fptc.adopt(state.out[3], n_particles, "f_ptc");
+    } else {
+        i_evt = state.ievt.allocate(n_events);
+        f_evt = state.fevt.allocate(n_events);
+        i_ptc = state.iptc.allocate(n_particles);
+        f_ptc = state.fptc.allocate(n_particles);
+    }
+
+    state.n_events  = n_events;
+    state.n_weights = n_weights;
+    state.n_particles = n_particles;
+}
+
+// ---------------------------------------------------------------------------
+// Multi-threaded parse – the event body is split on <event> boundaries
+// ---------------------------------------------------------------------------
+
+// run fn(0..n-1) on n threads, rethrowing the first exception after all have joined
+template <typename F>
+static void parallelFor(int n, F fn)
+{
+    std::vector<std::exception_ptr> errors(n);
+    std::vector<std::thread> workers;
+    workers.reserve(n);
+    for (int k = 0; k < n; ++k)
+        workers.emplace_back([&, k] {
+            try { fn(k); }
+            catch (...) { errors[k] = std::current_exception(); }
+        });
+    for (auto& w : workers) w.join();
+    for (auto& e : errors)
+        if (e) std::rethrow_exception(e);
+}
+
+// file offset of the first <event> tag at or after `from`, or `limit` if there is none
+static size_t nextEventOffset(const std::string& filename, const InputInfo& input, size_t from, size_t limit)
+{
+    auto src = openRange(filename, from, limit - from, &input);
+    std::string buf;
+    size_t base = from;  // file offset of buf[0]
+
+    for (std::string_view block = src->next(); !block.empty(); block = src->next()) {
+        buf.append(block);
+        size_t pos = findEventTag(buf);
+        if (pos != std::string::npos) return base + pos;
+        size_t keep = std::min<size_t>(buf.size(), 6);   // "<event" may straddle two blocks
+        base += buf.size() - keep;
+        buf.erase(0, buf.size() - keep);
+    }
+    return limit;
+}
+
+static size_t nextEventOffset(std::string_view data, size_t from, size_t limit)
+{
+    return std::min(findEventTag(data.substr(0, limit), from), limit);
+}
+
+// offset of the closing </LesHouchesEvents>, or the file size if it is missing
+static size_t bodyEndOffset(std::string_view data)
+{
+    size_t pos = data.rfind("</LesHouchesEvents>");
+    return pos == std::string_view::npos ? data.size() : pos;
+}
+
+static size_t bodyEndOffset(const std::string& filename, const InputInfo& input)
+{
+    constexpr size_t TAIL = 65536;
+    size_t file_size = input.size;
+    size_t from = file_size > TAIL ? file_size - TAIL : 0;
+    std::string tail(file_size - from, '\0');
+    tail.resize(openRange(filename, from, std::string::npos, &input)->read(tail.data(), tail.size()));
+    size_t pos = tail.rfind("</LesHouchesEvents>");
+    return pos == std::string::npos ? file_size : from + pos;
+}
+
+// pass 2 over consecutive byte ranges of whole events (`cuts`), one thread each: range k
+// fills the rows from evt_off[k] / ptc_off[k] on of the arrays allocated here through
+// `shape`; with select= the number of rows is not known up front, so every range fills
+// growable buffers of its own, which are copied together once all are done
+static void parseRanges(const std::string& filename, const InputInfo& input, const MappedFile* map,
+                        const std::vector<size_t>& cuts,
+                        std::vector<int64_t> evt_off, std::vector<int64_t> ptc_off,
+                        const std::vector<std::string>& weight_ids, int engine, ParseState& shape,
+                        py::object& i_evt, py::object& f_evt, py::object& i_ptc, py::object& f_ptc)
+{
+    std::string_view data = map ? map->view() : std::string_view();
+    // one source per range (its length keeps it inside the range), each with its own
+    // reader thread under prefetch=
+    auto rangeSource = [&](size_t begin, size_t end) {
+        return prefetched(openRange(filename, begin, end - begin, &input), shape.reading, isRemote(filename));
+    };
+    int  n_ranges  = static_cast<int>(cuts.size()) - 1;
+    int  n_weights = static_cast<int>(weight_ids.size());
+    bool selective = shape.selection != nullptr;
+
+    if (!selective) {
+        py::gil_scoped_acquire gil;
+        allocateArrays(shape, evt_off.back(), weight_ids, ptc_off.back(), i_evt, f_evt, i_ptc, f_ptc);
+    }
+
+    std::vector<std::unique_ptr<ParseState>> states(n_ranges);
+    std::vector<ParseStats> range_stats(n_ranges);
+    std::vector<EventSums>  range_sums(n_ranges);
+    auto t0 = SteadyClock::now();
+    parallelFor(n_ranges, [&](int k) {
+        states[k] = std::make_unique<ParseState>();
+        ParseState& state = *states[k];
+        state.want_extras = shape.want_extras;
+        state.stats.enabled = shape.stats.enabled;
+        state.sums.enabled  = shape.sums.enabled;
+        state.reading     = shape.reading;
+        if (selective) {
+            state.growable           = true;
+            configureOutputs(state, shape.ievt.layout, shape.iptc.dtype, shape.compact);
+            state.projection         = shape.projection;
+            state.selection          = shape.selection;
+            state.weight_ids         = weight_ids;
+            state.n_declared_weights = n_weights;
+        } else {
+            state.ievt.cols   = shape.ievt.cols;
+            state.fevt.cols   = shape.fevt.cols;
+            state.iptc.cols   = shape.iptc.cols;
+            state.fptc.cols   = shape.fptc.cols;
+            state.n_weights   = n_weights;
+            state.cur_event   = evt_off[k];      // also makes evt_idx global
+            state.cur_particle = ptc_off[k];
+            state.n_events    = evt_off[k + 1];  // end of this slice
+            state.n_particles = ptc_off[k + 1];
+        }
+
+        std::string_view range = map ? data.substr(cuts[k], cuts[k + 1] - cuts[k]) : std::string_view();
+
+        if (engine == ENGINE_FAST) {
+            if (map) runScanner(&state, range, cuts[k]);
+            else {
+                auto src = rangeSource(cuts[k], cuts[k + 1]);
+                src->setBlockSize(state.reading.chunk_size);
+                runScanner(&state, *src, cuts[k]);
+            }
+        } else {
+            // the range is a sequence of <event> elements: give expat a root to put them in
+            static const char root[] = "<LesHouchesEvents>";
+            XML_Parser parser = createParser(&state);
+            try {
+                XML_Parse(parser, root, sizeof(root) - 1, 0);
+                if (map) {
+                    // byte index 0 is the start of the synthetic root
+                    state.input_base = range.data() - (sizeof(root) - 1);
+                    runParser(parser, range, false);
+                } else {
+                    runParser(parser, *rangeSource(cuts[k], cuts[k + 1]), false);
+                }
+            } catch (...) { XML_ParserFree(parser); throw; }
+            XML_ParserFree(parser);
+        }
+        range_stats[k]       = state.stats;
+        range_stats[k].bytes = cuts[k + 1] - cuts[k];
+        range_sums[k]        = std::move(state.sums);
+
+        if (selective) return;
+        if (state.cur_event != evt_off[k + 1])
+            throw std::runtime_error("Event count mismatch in byte range starting at " + std::to_string(cuts[k]));
+        if (!state.want_extras) states[k].reset();
+    });
+    if (shape.stats.enabled) {
+        shape.stats.parse_seconds += secondsSince(t0);
+        for (const ParseStats& st : range_stats) shape.stats.add(st);
+    }
+    for (const EventSums& sums : range_sums) shape.sums.add(sums);  // in file order
+    // extras of each range, one after the other
+    if (shape.want_extras)
+        for (const auto& state : states) shape.extras.append(state->extras);
+    if (!selective) return;
+
+    // the accepted rows of each range, one after the other; evt_idx was counted per range
+    for (int k = 0; k < n_ranges; ++k) {
+        evt_off[k + 1] = evt_off[k] + states[k]->cur_event;
+        ptc_off[k + 1] = ptc_off[k] + states[k]->cur_particle;
+    }
+    {
+        py::gil_scoped_acquire gil;
+        allocateArrays(shape, evt_off.back(), weight_ids, ptc_off.back(), i_evt, f_evt, i_ptc, f_ptc);
+    }
+    parallelFor(n_ranges, [&](int k) {
+        const ParseState& state = *states[k];
+        shape.ievt.copyRows(state.ievt, state.cur_event, evt_off[k]);
+        shape.fevt.copyRows(state.fevt, state.cur_event, evt_off[k]);
+        shape.iptc.copyRows(state.iptc, state.cur_particle, ptc_off[k]);
+        shape.fptc.copyRows(state.fptc, state.cur_particle, ptc_off[k]);
+        const Column& idx = shape.iptc.cols[0];
+        if (idx.base && evt_off[k] > 0)
+            for (int64_t r = ptc_off[k]; r < ptc_off[k + 1]; ++r) storeInt(idx, r, loadInt(idx, r) + evt_off[k]);
+    });
+}
+
+static ParsedFile parseThreaded(const std::string& filename, const InputInfo& input, int n_threads, int engine, bool use_mmap,
+                                int layout, int index_dtype, bool compact, const Projection& projection,
+                                std::shared_ptr<const Selection> selection, int extras, bool stats,
+                                const ReadOptions& reading, const py::object* out_arrays, bool sums)
+{
+    if (input.format != FORMAT_PLAIN)
+        throw std::invalid_argument("n_threads > 1 needs an uncompressed file: " + filename);
+
+    // declared before nogil, so the arrays are released with the GIL held again
+    ParsedFile out;
+    // nothing below touches Python except allocating the arrays
+    py::gil_scoped_release nogil;
+
+    // with mmap every thread reads its range straight from the shared mapping
+    std::unique_ptr<MappedFile> map;
+    std::string_view data;
+    if (use_mmap) {
+        map  = std::make_unique<MappedFile>(filename);
+        data = map->view();
+    }
+
+    ParseState shape;
+    configureOutputs(shape, layout, index_dtype, compact);
+    shape.projection = projection;
+    shape.selection  = std::move(selection);
+    shape.want_extras = extras;
+    shape.stats.enabled = stats;
+    shape.sums.enabled  = sums;
+    shape.reading     = reading;
+    shape.out         = out_arrays;
+
+    // header (<initrwgt> etc.) up to the first <event>, parsed as usual
+    ParseState header;
+    header.stop_at_event = true;
+    header.reading       = reading;
+    auto t0 = SteadyClock::now();
+    XML_Parser parser = createParser(&header);
+    try {
+        if (map) runParser(parser, data, true);
+        else     runParser(parser, *openRange(filename, 0, std::string::npos, &input), true);
+    } catch (...) { XML_ParserFree(parser); throw; }
+    XML_ParserFree(parser);
+    if (stats) shape.stats.parse_seconds += secondsSince(t0);
+
+    if (header.body_begin == std::string::npos)
+        throw std::runtime_error("Found no events, weights, or particles.");
+    size_t body_begin = header.body_begin;
+    size_t body_end   = map ? bodyEndOffset(data) : bodyEndOffset(filename, input);
+
+    // cut the body into n_threads byte ranges, each starting on an <event>
+    std::vector<size_t> cuts{body_begin};
+    for (int k = 1; k < n_threads; ++k) {
+        size_t target = std::max(body_begin + (body_end - body_begin) * k / n_threads, cuts.back() + 1);
+        size_t cut = map ? nextEventOffset(data, target, body_end) : nextEventOffset(filename, input, target, body_end);
+        if (cut < body_end) cuts.push_back(cut);
+    }
+    cuts.push_back(body_end);
+    int n_ranges = static_cast<int>(cuts.size()) - 1;
+
+    // one source per range (its length keeps it inside the range)
+    auto rangeSource = [&](size_t begin, size_t end) { return openRange(filename, begin, end - begin, &input); };
+
+    // --- Pass 1, per range ---
+    t0 = SteadyClock::now();
+    Dimensions head;
+    if (map) head = countDimensions(data.substr(0, body_begin));
+    else     head = countDimensions(*rangeSource(0, body_begin));
+    int n_weights = head.n_weights;
+    std::vector<int64_t> evt_off(n_ranges + 1, 0), ptc_off(n_ranges + 1, 0);
+    // select=: the rows are only known after parsing, parseRanges() counts them instead
+    if (!shape.selection) parallelFor(n_ranges, [&](int k) {
+        Dimensions dims;
+        if (map) dims = countDimensions(data.substr(cuts[k], cuts[k + 1] - cuts[k]));
+        else     dims = countDimensions(*rangeSource(cuts[k], cuts[k + 1]));
+        evt_off[k + 1] = dims.n_events;
+        ptc_off[k + 1] = dims.n_particles;
+    });
+    for (int k = 0; k < n_ranges; ++k) { // prefix sums -> first row of each range
+        evt_off[k + 1] += evt_off[k];
+        ptc_off[k + 1] += ptc_off[k];
+    }
+    if (stats) shape.stats.count_seconds += secondsSince(t0);
+
+    if ((!shape.selection && (evt_off.back() == 0 || ptc_off.back() == 0)) || n_weights == 0)
+        throw std::runtime_error("Found no events, weights, or particles.");
+
+    // --- Pass 2, per range: each thread fills its own slice of the shared arrays ---
+    parseRanges(filename, input, map.get(), cuts, evt_off, ptc_off, head.weight_ids, engine, shape,
+                out.i_evt, out.f_evt, out.i_ptc, out.f_ptc);
+    out.reweight     = std::move(header.reweight);
+    out.init         = std::move(header.init);
+    out.extras_kinds = extras;
+    out.extras       = std::move(shape.extras);
+    out.n_events     = shape.n_events;
+    out.stats        = shape.stats;
+    out.sums         = std::move(shape.sums);
+
+    py::gil_scoped_acquire gil;
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Event index – build_index() writes <file>.idx next to an uncompressed file: the offset
+// and particle count of every event, the <weight> ids and the parsed <initrwgt>, so that
+// a re-open skips pass 1 and the header, and start/stop can seek to any event range
+// ---------------------------------------------------------------------------
+// the last byte is the version: 3 stores mtime in seconds since the epoch
+static constexpr char INDEX_MAGIC[8] = {'Q', 'L', 'H', 'E', 'I', 'D', 'X', '3'};
+
+struct EventIndex
+{
+    uint64_t file_size = 0;              // of the indexed file, to tell a stale index
+    int64_t  mtime     = 0;              // seconds since the epoch (InputInfo::mtime)
+    std::vector<int64_t> offsets;        // of each <event> tag, then of the end of the body
+    std::vector<int32_t> particles;      // per event
+    std::vector<std::string> weight_ids;
+    ReweightInfo reweight;
+    InitInfo     init;
+
+    int64_t nEvents() const { return static_cast<int64_t>(particles.size()); }
+};
+
+// next to the file; for a URL in $QUICKLHE_INDEX_DIR (else the temporary directory), under
+// a name made from the URL
+static std::string indexPath(const std::string& filename)
+{
+    if (!isRemote(filename)) return filename + ".idx";
+    const char* dir = std::getenv("QUICKLHE_INDEX_DIR");
+    std::filesystem::path base = dir && *dir ? std::filesystem::path(dir) : std::filesystem::temp_directory_path();
+    char hash[16];
+    char* end = std::to_chars(hash, hash + sizeof hash, std::hash<std::string>{}(filename), 16).ptr;
+    std::string name = filename.substr(filename.find_last_of('/') + 1);
+    for (char& c : name)
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '-' && c != '_') c = '_';
+    return (base / ("quicklhe-" + std::string(hash, end) + "-" + name + ".idx")).string();
+}
+
+// little helpers for the index and converted files: fixed-size values in native byte
+// order, strings prefixed by their length
+struct IndexWriter
+{
+    std::string out;
+
+    template <typename T> void put(T v) { out.append(reinterpret_cast<const char*>(&v), sizeof v); }
+    void put(const std::string& v) { put<uint64_t>(v.size()); out.append(v); }
+    template <typename T> void putArray(const std::vector<T>& v)
+    {
+        put<uint64_t>(v.size());
+        out.append(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+    }
+};
+
+struct IndexReader
+{
+    std::string_view in;
+
+    void need(size_t n) const { if (in.size() < n) throw std::runtime_error("Truncated file"); }
+    template <typename T> T get()
+    {
+        need(sizeof(T));
+        T v;
+        std::memcpy(&v, in.data(), sizeof v);
+        in.remove_prefix(sizeof v);
+        return v;
+    }
+    std::string getString()
+    {
+        size_t n = get<uint64_t>();
+        need(n);
+        std::string v(in.substr(0, n));
+        in.remove_prefix(n);
+        return v;
+    }
+    template <typename T> void getArray(std::vector<T>& v)
+    {
+        size_t n = get<uint64_t>();
+        need(n * sizeof(T));
+        v.resize(n);
+        std::memcpy(v.data(), in.data(), n * sizeof(T));
+        in.remove_prefix(n * sizeof(T));
+    }
+};
+
+// per group: name, combine, its weights with their attributes and contents
+static void putReweight(IndexWriter& w, const ReweightInfo& reweight)
+{
+    w.put<uint64_t>(reweight.groups.size());
+    size_t k = 0;
+    for (size_t g = 0; g < reweight.groups.size(); ++g) {
+        w.put(reweight.str(reweight.groups[g].name));
+        w.put(reweight.str(reweight.groups[g].combine));
+        w.put<uint8_t>(reweight.groups[g].has_combine);
+        size_t first = k;
+        while (k < reweight.weights.size() && reweight.weights[k].group == g) ++k;
+        w.put<uint64_t>(k - first);
+        for (size_t i = first; i < k; ++i) {
+            const RwgtWeight& rw = reweight.weights[i];
+            w.put<int32_t>(rw.id);
+            w.put<uint64_t>(rw.n_attrs);
+            for (uint32_t a = rw.first_attr; a < rw.first_attr + rw.n_attrs; ++a) {
+                w.put(reweight.str(reweight.attributes[a].key));
+                w.put(reweight.str(reweight.attributes[a].value));
+            }
+            w.put(reweight.str(rw.contents));
+        }
+    }
+}
+
+static void getReweight(IndexReader& r, ReweightInfo& reweight)
+{
+    reweight = ReweightInfo{};
+    reweight.groups.resize(r.get<uint64_t>());
+    for (size_t g = 0; g < reweight.groups.size(); ++g) {
+        RwgtGroup& group  = reweight.groups[g];
+        group.name        = reweight.add(r.getString());
+        group.combine     = reweight.add(r.getString());
+        group.has_combine = r.get<uint8_t>() != 0;
+        uint64_t n_weights = r.get<uint64_t>();
+        for (uint64_t i = 0; i < n_weights; ++i) {
+            RwgtWeight rw;
+            rw.id         = r.get<int32_t>();
+            rw.group      = static_cast<uint32_t>(g);
+            rw.first_attr = static_cast<uint32_t>(reweight.attributes.size());
+            rw.n_attrs    = static_cast<uint32_t>(r.get<uint64_t>());
+            for (uint32_t a = 0; a < rw.n_attrs; ++a) {
+                TextSpan key = reweight.add(r.getString());
+                reweight.attributes.push_back({key, reweight.add(r.getString())});
+            }
+            rw.contents = reweight.add(r.getString());
+            reweight.weights.push_back(rw);
+        }
+    }
+}
+
+// found, the beam line, then the four process columns
+static void putInit(IndexWriter& w, const InitInfo& init)
+{
+    w.put<uint8_t>(init.found);
+    for (int b = 0; b < 2; ++b) {
+        w.put(init.idbmup[b]);
+        w.put(init.ebmup[b]);
+        w.put(init.pdfgup[b]);
+        w.put(init.pdfsup[b]);
+    }
+    w.put(init.idwtup);
+    w.putArray(init.xsecup);
+    w.putArray(init.xerrup);
+    w.putArray(init.xmaxup);
+    w.putArray(init.lprup);
+}
+
+static void getInit(IndexReader& r, InitInfo& init)
+{
+    init = InitInfo{};
+    init.found = r.get<uint8_t>() != 0;
+    for (int b = 0; b < 2; ++b) {
+        init.idbmup[b] = r.get<int64_t>();
+        init.ebmup[b]  = r.get<double>();
+        init.pdfgup[b] = r.get<int64_t>();
+        init.pdfsup[b] = r.get<int64_t>();
+    }
+    init.idwtup = r.get<int64_t>();
+    r.getArray(init.xsecup);
+    r.getArray(init.xerrup);
+    r.getArray(init.xmaxup);
+    r.getArray(init.lprup);
+    size_t n = init.lprup.size();
+    if (init.xsecup.size() != n || init.xerrup.size() != n || init.xmaxup.size() != n)
+        throw std::runtime_error("Corrupt <init> record");
+}
+
+// scan an uncompressed file: header with expat, events with the pass 1 line scan; a local
+// file is mapped, a remote one streamed once
+static EventIndex scanIndex(const std::string& filename, const InputInfo& input)
+{
+    std::unique_ptr<MappedFile> map;
+    std::string_view data;
+    if (!isRemote(filename)) {
+        map  = std::make_unique<MappedFile>(filename);
+        data = map->view();
+    }
+
+    ParseState header;
+    header.stop_at_event = true;
+    XML_Parser parser = createParser(&header);
+    try {
+        if (map) runParser(parser, data, true);
+        else     runParser(parser, *openRange(filename, 0, std::string::npos, &input), true);
+    } catch (...) { XML_ParserFree(parser); throw; }
+    XML_ParserFree(parser);
+    if (header.body_begin == std::string::npos)
+        throw std::runtime_error("Found no events, weights, or particles.");
+    size_t body_begin = header.body_begin;
+
+    EventIndex index;
+    index.file_size  = input.size;
+    index.mtime      = input.mtime;
+    index.weight_ids = (map ? countDimensions(data.substr(0, body_begin))
+                            : countDimensions(*openRange(filename, 0, body_begin, &input))).weight_ids;
+    index.reweight   = std::move(header.reweight);
+    index.init       = std::move(header.init);
+
+    size_t body_end = map ? bodyEndOffset(data) : bodyEndOffset(filename, input);
+    Dimensions body;
+    if (map) {
+        body.base = data.data();
+        countLines(data.substr(0, body_end).substr(body_begin), body, true);
+    } else {
+        auto src = prefetched(openRange(filename, body_begin, body_end - body_begin, &input), ReadOptions(), true);
+        body = countDimensions(*src, static_cast<int64_t>(body_begin));
+    }
+    index.offsets   = std::move(body.event_offsets);
+    index.particles = std::move(body.event_particles);
+    index.offsets.push_back(static_cast<int64_t>(body_end));
+    return index;
+}
+
+static void writeIndex(const EventIndex& index, const std::string& path)
+{
+    IndexWriter w;
+    w.out.append(INDEX_MAGIC, sizeof INDEX_MAGIC);
+    w.put(index.file_size);
+    w.put(index.mtime);
+    w.putArray(index.offsets);
+    w.putArray(index.particles);
+    w.put<uint64_t>(index.weight_ids.size());
+    for (const std::string& id : index.weight_ids) w.put(id);
+    putReweight(w, index.reweight);
+    putInit(w, index.init);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(w.out.data(), static_cast<std::streamsize>(w.out.size()));
+    if (!out) throw std::runtime_error("Cannot write index file: " + path);
+}
+
+// the index of `filename` if there is one and it matches the file as it is now
+static bool loadIndex(const std::string& filename, const InputInfo& input, EventIndex& index)
+{
+    std::ifstream in(indexPath(filename), std::ios::binary);
+    if (!in) return false;
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    IndexReader r{bytes};
+    if (bytes.size() < sizeof INDEX_MAGIC || std::memcmp(bytes.data(), INDEX_MAGIC, sizeof INDEX_MAGIC - 1) != 0)
+        throw std::runtime_error("Not an LHE index file: " + indexPath(filename));
+    if (bytes[sizeof INDEX_MAGIC - 1] != INDEX_MAGIC[sizeof INDEX_MAGIC - 1])
+        return false; // written by an older version (without <init>, or mtime in file clock
+                      // ticks): ignore it like a stale one
+    r.in.remove_prefix(sizeof INDEX_MAGIC);
+    index.file_size = r.get<uint64_t>();
+    index.mtime     = r.get<int64_t>();
+    if (index.file_size != input.size || index.mtime != input.mtime)
+        return false; // the file changed since: ignore the index
+
+    r.getArray(index.offsets);
+    r.getArray(index.particles);
+    if (index.offsets.size() != index.particles.size() + 1)
+        throw std::runtime_error("Corrupt index file: " + indexPath(filename));
+    index.weight_ids.resize(r.get<uint64_t>());
+    for (std::string& id : index.weight_ids) id = r.getString();
+    getReweight(r, index.reweight);
+    getInit(r, index.init);
+    return true;
+}
+
+// events [start, stop) of an indexed file, on up to n_threads ranges of about equal size
+static ParsedFile parseIndexed(const std::string& filename, const InputInfo& input, const EventIndex& index,
+                               int64_t start, int64_t stop,
+                               int n_threads, int engine, bool use_mmap, int layout, int index_dtype,
+                               bool compact, const Projection& projection, std::shared_ptr<const Selection> selection,
+                               int extras, bool stats, const ReadOptions& reading, const py::object* out_arrays,
+                               bool sums)
+{
+    ParsedFile out;
+    py::gil_scoped_release nogil;
+
+    if (index.nEvents() == 0 || index.weight_ids.empty())
+        throw std::runtime_error("Found no events, weights, or particles.");
+
+    std::unique_ptr<MappedFile> map;
+    if (use_mmap) map = std::make_unique<MappedFile>(filename);
+
+    // cut on the event offsets, so no range has to be searched for its first <event>; no
+    // more ranges than events, and an empty [start, stop) stays one empty range
+    const std::vector<int64_t>& offsets = index.offsets;
+    n_threads = static_cast<int>(std::min<int64_t>(n_threads, stop - start));
+    std::vector<int64_t> first{start};
+    for (int k = 1; k < n_threads; ++k) {
+        int64_t target = offsets[start] + (offsets[stop] - offsets[start]) * k / n_threads;
+        int64_t e = std::lower_bound(offsets.begin() + first.back() + 1, offsets.begin() + stop, target) - offsets.begin();
+        if (e < stop) first.push_back(e);
+    }
+    first.push_back(stop);
+
+    int n_ranges = static_cast<int>(first.size()) - 1;
+    std::vector<size_t> cuts(n_ranges + 1);
+    std::vector<int64_t> evt_off(n_ranges + 1, 0), ptc_off(n_ranges + 1, 0);
+    for (int k = 0; k <= n_ranges; ++k) {
+        cuts[k]    = static_cast<size_t>(offsets[first[k]]);
+        evt_off[k] = first[k] - start;
+        if (k > 0) ptc_off[k] = ptc_off[k - 1] + std::accumulate(index.particles.begin() + first[k - 1],
+                                                                  index.particles.begin() + first[k], int64_t(0));
+    }
+
+    ParseState shape;
+    configureOutputs(shape, layout, index_dtype, compact);
+    shape.projection = projection;
+    shape.selection  = std::move(selection);
+    shape.want_extras = extras;
+    shape.stats.enabled = stats;
+    shape.sums.enabled  = sums;
+    shape.reading     = reading;
+    shape.out         = out_arrays;
+    parseRanges(filename, input, map.get(), cuts, evt_off, ptc_off, index.weight_ids, engine, shape,
+                out.i_evt, out.f_evt, out.i_ptc, out.f_ptc);
+    out.reweight     = index.reweight;
+    out.init         = index.init;
+    out.extras_kinds = extras;
+    out.extras       = std::move(shape.extras);
+    out.n_events     = shape.n_events;
+    out.stats        = shape.stats;
+    out.sums         = std::move(shape.sums);
+
+    py::gil_scoped_acquire gil;
+    return out;
+}
+
+// build_index(): scan the file once and write the index next to it (a URL's locally)
+std::string buildIndex(const std::string& filename)
+{
+    InputInfo input = probeInput(filename);
+    if (input.format != FORMAT_PLAIN)
+        throw std::invalid_argument("build_index needs an uncompressed file: " + filename);
+    py::gil_scoped_release nogil;
+    std::string path = indexPath(filename);
+    writeIndex(scanIndex(filename, input), path);
+    return path;
+}
+
+// chunk_size=, prefetch= and prefetch_size= arguments; sizes fit the int XML_GetBuffer takes
+static ReadOptions readOptions(int64_t chunk_size, const py::object& prefetch, int64_t prefetch_size)
+{
+    ReadOptions reading;
+    if (chunk_size < 4096 || chunk_size > (int64_t(1) << 30))
+        throw std::invalid_argument("chunk_size must be between 4096 and 2**30 bytes");
+    if (prefetch_size < 4096 || prefetch_size > (int64_t(1) << 30))
+        throw std::invalid_argument("prefetch_size must be between 4096 and 2**30 bytes");
+    reading.chunk_size    = static_cast<size_t>(chunk_size);
+    reading.prefetch_size = static_cast<size_t>(prefetch_size);
+    if (!prefetch.is_none()) {
+        int64_t depth = prefetch.cast<int64_t>();
+        if (depth < 0 || depth > 256)
+            throw std::invalid_argument("prefetch must be None or a number of blocks from 0 to 256");
+        reading.prefetch = static_cast<int>(depth);
+    }
+    return reading;
+}
+
+// start/stop arguments: events [start, stop) of the file, stop=None for all the rest
+static void checkRange(int64_t start, const std::optional<int64_t>& stop)
+{
+    if (start < 0 || (stop && *stop < start))
+        throw std::invalid_argument("start and stop must satisfy 0 <= start <= stop");
+}
+
+static std::pair<int64_t, int64_t> clipRange(int64_t start, const std::optional<int64_t>& stop, int64_t n_events)
+{
+    int64_t end = stop ? std::min(*stop, n_events) : n_events;
+    return {std::min(start, end), end};
+}
+
+// the index of a plain file: from its .idx if that is current, else (`scan`) built in memory
+static bool findIndex(const std::string& filename, const InputInfo& input, bool scan, EventIndex& index)
+{
+    if (input.format == FORMAT_PLAIN && loadIndex(filename, input, index)) return true;
+    if (!scan) return false;
+    if (input.format != FORMAT_PLAIN)
+        throw std::invalid_argument("start and stop need an uncompressed file: " + filename);
+    index = scanIndex(filename, input);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Arrow export – layout="arrow" hands the events out as one Arrow struct array through the
+// Arrow C data interface (__arrow_c_array__), so pyarrow, polars or awkward take them over
+// without a copy: the event fields, then "particles", a list of particle structs whose
+// offsets replace evt_idx. The value buffers are the numpy columns of layout="dict"
+// ---------------------------------------------------------------------------
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+// as given by the Arrow C data interface specification (a stable ABI)
+struct ArrowSchema
+{
+    const char*   format;
+    const char*   name;
+    const char*   metadata;
+    int64_t       flags;
+    int64_t       n_children;
+    ArrowSchema** children;
+    ArrowSchema*  dictionary;
+    void (*release)(ArrowSchema*);
+    void*         private_data;
+};
+
+struct ArrowArray
+{
+    int64_t      length;
+    int64_t      null_count;
+    int64_t      offset;
+    int64_t      n_buffers;
+    int64_t      n_children;
+    const void** buffers;
+    ArrowArray** children;
+    ArrowArray*  dictionary;
+    void (*release)(ArrowArray*);
+    void*        private_data;
+};
+#endif
+
+static const char* arrowFormat(int dtype)
+{
+    switch (dtype) {
+        case DT_INT8:    return "c";
+        case DT_INT16:   return "s";
+        case DT_INT32:   return "i";
+        case DT_INT64:   return "l";
+        case DT_FLOAT32: return "f";
+        default:         return "g";
+    }
+}
+
+// one node of the exported type: a column with its values, or a struct or list ("+s",
+// "+l", "+L") of the children, a list with its offsets as `data`
+struct ArrowField
+{
+    std::string name;
+    std::string format;
+    int64_t     length = 0;
+    const void* data   = nullptr;
+    std::vector<ArrowField> children;
+};
+
+// what the exported arrays point to, shared by all of them: a consumer may release
+// (moved-out) children separately, the last one drops the numpy columns
+struct ArrowEventsData
+{
+    std::vector<py::object> arrays;
+    std::vector<int32_t>    offsets32;  // "+l", or
+    std::vector<int64_t>    offsets64;  // "+L" beyond 2^31 particles
+    ArrowField              root;
+
+    ~ArrowEventsData()
+    {
+        py::gil_scoped_acquire gil; // the consumer may release from any thread
+        arrays.clear();
+    }
+};
+
+struct SchemaPrivate
+{
+    std::string format, name;
+    std::vector<ArrowSchema>  child_schemas;
+    std::vector<ArrowSchema*> children;
+};
+
+struct ArrayPrivate
+{
+    std::shared_ptr<const ArrowEventsData> data;
+    const void* buffers[2] = {nullptr, nullptr};  // no validity bitmap: nothing is null
+    std::vector<ArrowArray>  child_arrays;
+    std::vector<ArrowArray*> children;
+};
+
+static void releaseSchema(ArrowSchema* schema)
+{
+    auto* p = static_cast<SchemaPrivate*>(schema->private_data);
+    for (ArrowSchema* child : p->children)
+        if (child->release) child->release(child); // unless the consumer moved it out
+    delete p;
+    schema->release = nullptr;
+}
+
+static void releaseArray(ArrowArray* array)
+{
+    auto* p = static_cast<ArrayPrivate*>(array->private_data);
+    for (ArrowArray* child : p->children)
+        if (child->release) child->release(child);
+    delete p;
+    array->release = nullptr;
+}
+
+static void exportField(const ArrowField& f, const std::shared_ptr<const ArrowEventsData>& data,
+                        ArrowSchema* schema, ArrowArray* array)
+{
+    size_t n = f.children.size();
+    auto* sp = new SchemaPrivate{f.format, f.name, std::vector<ArrowSchema>(n), {}};
+    auto* ap = new ArrayPrivate{data, {nullptr, f.data}, std::vector<ArrowArray>(n), {}};
+    for (size_t c = 0; c < n; ++c) {
+        sp->children.push_back(&sp->child_schemas[c]);
+        ap->children.push_back(&ap->child_arrays[c]);
+        exportField(f.children[c], data, &sp->child_schemas[c], &ap->child_arrays[c]);
+    }
+    auto n_children = static_cast<int64_t>(n);
+    *schema = ArrowSchema{sp->format.c_str(), sp->name.c_str(), nullptr, 0, n_children, sp->children.data(),
+                          nullptr, releaseSchema, sp};
+    *array  = ArrowArray{f.length, 0, 0, f.format == "+s" ? 1 : 2, n_children, ap->buffers, ap->children.data(),
+                         nullptr, releaseArray, ap};
+}
+
+class ArrowEvents
+{
+public:
+    // from the four outputs in layout="dict" holding n_events events, i_ptc with its evt_idx
+    // column; the count is passed in, an event without particles has no evt_idx entry
+    ArrowEvents(const py::object& i_evt, const py::object& f_evt, const py::object& i_ptc, const py::object& f_ptc,
+                int64_t n_events)
+    {
+        auto d = std::make_shared<ArrowEventsData>();
+        std::vector<ArrowField> evt_fields, ptc_fields;
+        py::array evt_idx;
+        bool has_evt_idx = false;
+        auto addColumns = [&](const py::object& arrays, std::vector<ArrowField>& fields) {
+            for (auto item : py::dict(arrays)) {
+                auto col = py::reinterpret_borrow<py::array>(item.second);
+                std::string name = item.first.cast<std::string>();
+                d->arrays.push_back(col);
+                if (name == "evt_idx" && &fields == &ptc_fields) {
+                    evt_idx     = col;
+                    has_evt_idx = true;
+                    continue;
+                }
+                fields.push_back({name, arrowFormat(dtypeCode(col.dtype())), static_cast<int64_t>(col.shape(0)),
+                                  col.data(), {}});
+            }
+        };
+        addColumns(i_evt, evt_fields);
+        addColumns(f_evt, evt_fields);
+        addColumns(i_ptc, ptc_fields);
+        addColumns(f_ptc, ptc_fields);
+        if (!has_evt_idx)
+            throw std::runtime_error("layout='arrow' needs the evt_idx column of i_ptc");
+
+        // particles per event from evt_idx (1.. within the output, ascending)
+        Column idx{const_cast<char*>(static_cast<const char*>(evt_idx.data())),
+                   static_cast<size_t>(evt_idx.itemsize()), dtypeCode(evt_idx.dtype())};
+        auto n_particles = static_cast<int64_t>(evt_idx.shape(0));
+        std::vector<int64_t> offsets(n_events + 1, 0);
+        for (int64_t r = 0, last = 1; r < n_particles; ++r) {
+            int64_t e = loadInt(idx, r);
+            if (e < last || e > n_events)
+                throw std::runtime_error("evt_idx is not an ascending event number");
+            ++offsets[e];
+            last = e;
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+        ArrowField particles{"particles", "+l", n_events, nullptr,
+                             {ArrowField{"item", "+s", n_particles, nullptr, std::move(ptc_fields)}}};
+        if (n_particles <= std::numeric_limits<int32_t>::max()) {
+            d->offsets32.assign(offsets.begin(), offsets.end());
+            particles.data = d->offsets32.data();
+        } else {
+            d->offsets64   = std::move(offsets);
+            particles.data = d->offsets64.data();
+            particles.format = "+L";
+        }
+        evt_fields.push_back(std::move(particles));
+        d->root = ArrowField{"", "+s", n_events, nullptr, std::move(evt_fields)};
+        data_ = std::move(d);
+    }
+
+    int64_t size() const { return data_->root.length; }
+
+    // __arrow_c_array__: a fresh export each call, released by its capsules unless a
+    // consumer moves it out of them; requested_schema is ignored, the types are fixed
+    py::tuple exportArray(const py::object& /*requested_schema*/) const
+    {
+        auto schema = std::make_unique<ArrowSchema>();
+        auto array  = std::make_unique<ArrowArray>();
+        exportField(data_->root, data_, schema.get(), array.get());
+        py::capsule schema_capsule(schema.get(), "arrow_schema", [](PyObject* o) {
+            auto* p = static_cast<ArrowSchema*>(PyCapsule_GetPointer(o, "arrow_schema"));
+            if (p->release) p->release(p);
+            delete p;
+        });
+        schema.release();
+        py::capsule array_capsule(array.get(), "arrow_array", [](PyObject* o) {
+            auto* p = static_cast<ArrowArray*>(PyCapsule_GetPointer(o, "arrow_array"));
+            if (p->release) p->release(p);
+            delete p;
+        });
+        array.release();
+        return py::make_tuple(schema_capsule, array_capsule);
+    }
+
+private:
+    std::shared_ptr<const ArrowEventsData> data_;
+};
+
+// ---------------------------------------------------------------------------
+// Main entry point exposed to Python
+// double passes LHE file, first to extract numbers of events, weights, and particles,
+// then to read all values into preallocated arrays passed directly into nupmy structures by pybind11
+// with single_pass, the first pass is skipped and the arrays are grown while parsing instead
+// compressed files (gzip, xz, zstd) are decompressed on the fly and never mapped
+// ---------------------------------------------------------------------------
+static ParsedFile parseFile(const std::string& filename, bool single_pass, int n_threads, const std::string& engine_name,
+                            bool use_mmap, const std::string& layout_name, const std::string& index_dtype_name,
+                            bool compact, const py::object& columns, const py::object& weights,
+                            const py::object& derived, int64_t start, std::optional<int64_t> stop,
+                            const std::string& select, int extras, bool stats, const ReadOptions& reading,
+                            const py::object* out_arrays, bool sums)
+{
+    int engine      = parseEngine(engine_name);
+    int layout      = parseLayout(layout_name);
+    int index_dtype = parseIndexDtype(index_dtype_name);
+    Projection projection = parseProjection(columns, weights, derived);
+    if (layout == LAYOUT_ARROW) keepColumn(projection, "evt_idx");
+    checkRange(start, stop);
+    std::shared_ptr<const Selection> selection;
+    if (!select.empty()) selection = std::make_shared<Selection>(select);
+    if (n_threads <= 0) n_threads = std::max(1u, std::thread::hardware_concurrency());
+    if (isRemote(filename)) use_mmap = false; // nothing to map: read by byte range
+
+    // an index replaces pass 1 (and single_pass) and the splitter's scan; start/stop need one
+    InputInfo input = probeInput(filename);
+    int format = input.format;
+    EventIndex index;
+    bool indexed;
+    {
+        py::gil_scoped_release nogil;
+        indexed = findIndex(filename, input, start > 0 || stop, index);
+    }
+    if (indexed) {
+        auto [first, last] = clipRange(start, stop, index.nEvents());
+        return parseIndexed(filename, input, index, first, last, n_threads, engine, use_mmap, layout, index_dtype, compact,
+                            projection, std::move(selection), extras, stats, reading, out_arrays, sums);
+    }
+
+    if (n_threads > 1) {
+        if (single_pass)
+            throw std::invalid_argument("single_pass is not supported with n_threads > 1");
+        return parseThreaded(filename, input, n_threads, engine, use_mmap, layout, index_dtype, compact, projection,
+                             std::move(selection), extras, stats, reading, out_arrays, sums);
+    }
+    if (selection) single_pass = true; // the number of accepted events is only known at the end
+
+    ParsedFile out;
+    // the counting pass and the parse run without the GIL, so other Python threads can
+    // parse other files meanwhile; the callbacks collect plain C++ data only
+    py::gil_scoped_release nogil;
+
+    ParseState state;
+    configureOutputs(state, layout, index_dtype, compact);
+    state.projection = std::move(projection);
+    state.selection  = std::move(selection);
+    state.want_extras = extras;
+    state.stats.enabled = stats;
+    state.sums.enabled  = sums;
+    state.reading     = reading;
+    state.out         = out_arrays;
+
+    std::unique_ptr<MappedFile> map;
+    std::string_view data;
+    if (use_mmap && format == FORMAT_PLAIN) {
+        map  = std::make_unique<MappedFile>(filename);
+        data = map->view();
+    }
+
+    if (!single_pass) {
+        // --- Pass 1 ---
+        Dimensions dims;
+        {
+            PhaseTimer timer(state.stats, state.stats.count_seconds);
+            dims = map ? countDimensions(data) : countDimensions(*openSource(filename, input, reading));
+        }
+        if (dims.n_events == 0 || dims.n_weights == 0 || dims.n_particles == 0)
+            throw std::runtime_error("Found no events, weights, or particles.");
+        py::gil_scoped_acquire gil;
+        allocateArrays(state, dims.n_events, dims.weight_ids, dims.n_particles,
+                       out.i_evt, out.f_evt, out.i_ptc, out.f_ptc);
+    } else {
+        state.growable = true;
+        state.file_size = format == FORMAT_PLAIN ? input.size : 0; // only used for the capacity estimate
+    }
+
+    runFile(state, filename, input, map.get(), engine);
+    if (!single_pass) { // rows pass 1 counted that the parse did not reach, zero as allocated before
+        state.ievt.clearRows(state.cur_event, state.n_events - state.cur_event);
+        state.fevt.clearRows(state.cur_event, state.n_events - state.cur_event);
+        state.iptc.clearRows(state.cur_particle, state.n_particles - state.cur_particle);
+        state.fptc.clearRows(state.cur_particle, state.n_particles - state.cur_particle);
+    }
+
+    py::gil_scoped_acquire gil;
+    if (single_pass) {
+        if (state.fevt.buf.capacity == 0 && state.n_rejected > 0) setWeightColumns(&state); // select= kept none
+        if (state.cur_event + state.n_rejected == 0 || state.n_weights == 0
+            || (state.cur_particle == 0 && !state.selection))
+            throw std::runtime_error("Found no events, weights, or particles.");
+
+        PhaseTimer timer(state.stats, state.stats.python_seconds);
+        out.i_evt = state.ievt.release(state.cur_event);
+        out.f_evt = state.fevt.release(state.cur_event);
+        out.i_ptc = state.iptc.release(state.cur_particle);
+        out.f_ptc = state.fptc.release(state.cur_particle);
+    }
+    out.reweight     = std::move(state.reweight);
+    out.init         = std::move(state.init);
+    out.extras_kinds = extras;
+    out.extras       = std::move(state.extras);
+    out.n_events     = single_pass ? state.cur_event : state.n_events;
+    out.stats        = state.stats;
+    out.sums         = std::move(state.sums);
+    return out;
+}
+
+py::tuple parseLHE(const std::string& filename, bool single_pass, int n_threads, const std::string& engine,
+                   bool use_mmap, const std::string& layout, const std::string& index_dtype,
+                   const py::object& columns, const py::object& weights, int64_t start,
+                   std::optional<int64_t> stop, const std::string& select, const std::string& reweight,
+                   bool extras, bool comments, bool init, bool compact, const py::object& derived, bool stats,
+                   int64_t chunk_size, const py::object& prefetch, int64_t prefetch_size, const py::object& out,
+                   bool sums)
+{
+    if (stats && !QUICKLHE_STATS)
+        throw std::invalid_argument("stats=True is not available in a build with QUICKLHE_NO_STATS");
+    auto t0 = SteadyClock::now();
+    bool table = parseReweightTable(reweight);
+    py::object out_arrays[4];
+    if (!out.is_none()) {
+        if (single_pass || !select.empty() || parseLayout(layout) == LAYOUT_ARROW)
+            throw std::invalid_argument("out= needs the row counts before parsing: not with single_pass, select or "
+                                        "layout='arrow'");
+        if (!py::isinstance<py::sequence>(out) || py::len(out) != 4)
+            throw std::invalid_argument("out= must be the four arrays (i_evt, f_evt, i_ptc, f_ptc)");
+        auto given = py::reinterpret_borrow<py::sequence>(out);
+        for (size_t k = 0; k < 4; ++k) out_arrays[k] = given[k];
+    }
+    ParsedFile parsed = parseFile(filename, single_pass, n_threads, engine, use_mmap, layout, index_dtype, compact,
+                                  columns, weights, derived, start, stop, select, extrasKinds(extras, comments), stats,
+                                  readOptions(chunk_size, prefetch, prefetch_size), out.is_none() ? nullptr : out_arrays,
+                                  sums);
+    py::list items;
+    {
+        PhaseTimer timer(parsed.stats, parsed.stats.python_seconds);
+        items.append(parsed.reweight.toPython(table));
+        if (parseLayout(layout) == LAYOUT_ARROW)
+            items.append(py::cast(ArrowEvents(parsed.i_evt, parsed.f_evt, parsed.i_ptc, parsed.f_ptc, parsed.n_events)));
+        else
+            for (const py::object& a : {parsed.i_evt, parsed.f_evt, parsed.i_ptc, parsed.f_ptc}) items.append(a);
+        parsed.appendOptional(items, init);
+        if (sums) items.append(parsed.sums.toPython());
+    }
+    if (stats) items.append(parsed.stats.toPython(secondsSince(t0)));
+    return py::tuple(items);
+}
+
+// ---------------------------------------------------------------------------
+// Multi-file parse – parse_many() merges the shards of a run into one set of arrays: every
+// file is counted (or its index read), the merged arrays are allocated once, and each file
+// is then parsed into its own slice of them. A file is parsed by one worker at a time
+// ---------------------------------------------------------------------------
+
+// run fn(i) for every i in `order` on up to n_threads threads, each taking the next one as
+// soon as it is done, so a few large files do not hold up the rest; the first exception
+// stops the queue and is rethrown after all have joined
+template <typename F>
+static void parallelQueue(const std::vector<size_t>& order, int n_threads, F fn)
+{
+    std::atomic<size_t> next{0};
+    parallelFor(std::min(n_threads, static_cast<int>(order.size())), [&](int) {
+        for (size_t i = next++; i < order.size(); i = next++) {
+            try { fn(order[i]); }
+            catch (...) { next = order.size(); throw; }
+        }
+    });
+}
+
+py::tuple parseMany(const std::vector<std::string>& filenames, int n_threads, const std::string& engine_name,
+                    bool use_mmap, const std::string& layout_name, const std::string& index_dtype_name,
+                    const py::object& columns, const py::object& weights, const std::string& reweight,
+                    bool compact, const py::object& derived)
+{
+    if (filenames.empty()) throw std::invalid_argument("parse_many needs at least one file");
+    int  engine      = parseEngine(engine_name);
+    int  layout      = parseLayout(layout_name);
+    int  index_dtype = parseIndexDtype(index_dtype_name);
+    bool table       = parseReweightTable(reweight);
+    Projection projection = parseProjection(columns, weights, derived);
+    if (layout == LAYOUT_ARROW) keepColumn(projection, "evt_idx");
+    if (n_threads <= 0) n_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    size_t n_files = filenames.size();
+    std::vector<InputInfo> inputs(n_files);
+    std::vector<size_t> order(n_files);
+    for (size_t f = 0; f < n_files; ++f) {
+        inputs[f] = probeInput(filenames[f]);
+        order[f]  = f;
+    }
+    // largest first, so the last files to finish are short ones
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return inputs[a].size > inputs[b].size; });
+
+    ParseState shape;
+    configureOutputs(shape, layout, index_dtype, compact);
+    shape.projection = std::move(projection);
+
+    ReweightInfo rwgt;
+    InitInfo     init;
+    py::object   i_evt, f_evt, i_ptc, f_ptc;
+    py::array_t<int32_t> file_idx;
+    {
+        py::gil_scoped_release nogil;
+
+        // --- Pass 1, per file: the header (<init>, <initrwgt>) and the counts ---
+        std::vector<Dimensions> dims(n_files);
+        std::vector<InitInfo>   inits(n_files);
+        parallelQueue(order, n_threads, [&](size_t f) {
+            const std::string& filename = filenames[f];
+            std::unique_ptr<MappedFile> map;
+            if (use_mmap && inputs[f].format == FORMAT_PLAIN && !isRemote(filename)) map = std::make_unique<MappedFile>(filename);
+
+            ParseState header;
+            header.stop_at_event = true;
+            header.input_base    = map ? map->view().data() : nullptr;
+            XML_Parser parser = createParser(&header);
+            try {
+                if (map) runParser(parser, map->view(), true);
+                else     runParser(parser, *openSource(filename, inputs[f]), true);
+            } catch (...) { XML_ParserFree(parser); throw; }
+            XML_ParserFree(parser);
+            inits[f] = std::move(header.init);
+            if (f == 0) rwgt = std::move(header.reweight);
+
+            EventIndex index;
+            if (findIndex(filename, inputs[f], false, index)) {
+                dims[f].n_events    = index.nEvents();
+                dims[f].n_particles = std::accumulate(index.particles.begin(), index.particles.end(), int64_t(0));
+                dims[f].weight_ids  = std::move(index.weight_ids);
+                dims[f].n_weights   = static_cast<int>(dims[f].weight_ids.size());
+            } else {
+                dims[f] = map ? countDimensions(map->view()) : countDimensions(*openSource(filename, inputs[f]));
+            }
+        });
+
+        std::vector<int64_t> evt_off(n_files + 1, 0), ptc_off(n_files + 1, 0);
+        for (size_t f = 0; f < n_files; ++f) {
+            if (dims[f].n_events == 0 || dims[f].n_weights == 0 || dims[f].n_particles == 0)
+                throw std::runtime_error("Found no events, weights, or particles in " + filenames[f]);
+            if (dims[f].weight_ids != dims[0].weight_ids)
+                throw std::runtime_error("Weights of " + filenames[f] + " do not match those of " + filenames[0]);
+            evt_off[f + 1] = evt_off[f] + dims[f].n_events;
+            ptc_off[f + 1] = ptc_off[f] + dims[f].n_particles;
+        }
+        init = mergeInit(inits, filenames);
+
+        int32_t* file_of = nullptr;
+        {
+            py::gil_scoped_acquire gil;
+            allocateArrays(shape, evt_off.back(), dims[0].weight_ids, ptc_off.back(), i_evt, f_evt, i_ptc, f_ptc);
+            file_idx = py::array_t<int32_t>({static_cast<py::ssize_t>(evt_off.back())});
+            file_of  = file_idx.mutable_data();
+        }
+
+        // --- Pass 2, per file: straight into its rows of the merged arrays ---
+        parallelQueue(order, n_threads, [&](size_t f) {
+            std::unique_ptr<MappedFile> map;
+            if (use_mmap && inputs[f].format == FORMAT_PLAIN && !isRemote(filenames[f]))
+                map = std::make_unique<MappedFile>(filenames[f]);
+
+            ParseState state;
+            state.ievt.cols    = shape.ievt.cols;
+            state.fevt.cols    = shape.fevt.cols;
+            state.iptc.cols    = shape.iptc.cols;
+            state.fptc.cols    = shape.fptc.cols;
+            state.n_weights    = dims[f].n_weights;
+            state.cur_event    = evt_off[f];      // also makes evt_idx count over all files
+            state.cur_particle = ptc_off[f];
+            state.n_events     = evt_off[f + 1];  // end of this file's rows
+            state.n_particles  = ptc_off[f + 1];
+            runFile(state, filenames[f], inputs[f], map.get(), engine);
+            if (state.cur_event != evt_off[f + 1] || state.cur_particle != ptc_off[f + 1])
+                throw std::runtime_error("Event count mismatch in " + filenames[f]);
+            std::fill(file_of + evt_off[f], file_of + evt_off[f + 1], static_cast<int32_t>(f));
+        });
+    }
+
+    if (layout != LAYOUT_ARROW)
+        return py::make_tuple(rwgt.toPython(table), i_evt, f_evt, i_ptc, f_ptc, file_idx, init.toPython());
+    py::object events = py::cast(ArrowEvents(i_evt, f_evt, i_ptc, f_ptc, shape.n_events));
+    return py::make_tuple(rwgt.toPython(table), events, file_idx, init.toPython());
+}
+
+// ---------------------------------------------------------------------------
+// Chunked iteration – iter_lhe() yields the arrays of chunk_events events at a time
+// expat is suspended after the last event of a chunk and resumed by the next call, so
+// the parser and its ParseState live as long as the iterator
+// ---------------------------------------------------------------------------
+
+// output buffer of one chunk, shared with the numpy arrays it was handed out as
+using SharedBuffer = std::shared_ptr<GrowableBuffer>;
+
+// before a chunk: take the memory of a slot back once numpy no longer uses it, so the
+// buffers are recycled instead of reallocated
+static void reclaimRows(SharedBuffer& slot, OutputArray& out)
+{
+    if (!slot || slot.use_count() > 1 || out.buf.capacity > 0) return;
+    out.buf.swap(*slot);
+}
+
+// after a chunk: move the rows into the slot and hand them to numpy without a copy; a slot
+// still referenced by arrays of an earlier chunk is left to them and replaced
+static py::object lendRows(SharedBuffer& slot, OutputArray& out, size_t rows)
+{
+    out.compact(rows);
+    if (!slot || slot.use_count() > 1) slot = std::make_shared<GrowableBuffer>();
+    slot->swap(out.buf);
+    auto* keep = new SharedBuffer(slot);
+    return out.view(slot->data, rows, py::capsule(keep, [](void* p) { delete static_cast<SharedBuffer*>(p); }));
+}
+
+class LHEIterator
+{
+public:
+    // with an index, only events [start, stop) are read, and the header comes from the index
+    LHEIterator(const std::string& filename, const InputInfo& input, int64_t chunk_events, int layout, int index_dtype, bool compact,
+                Projection projection, std::shared_ptr<const Selection> selection, int extras,
+                const ReadOptions& reading, bool sums, const EventIndex* index = nullptr, int64_t start = 0,
+                int64_t stop = 0)
+    {
+        if (chunk_events <= 0)
+            throw std::invalid_argument("chunk_events must be positive");
+        state_.growable     = true;   // file_size stays 0: no capacity estimate
+        state_.chunk_events = chunk_events;
+        configureOutputs(state_, layout, index_dtype, compact);
+        arrow_              = layout == LAYOUT_ARROW;
+        state_.projection   = std::move(projection);
+        state_.selection    = std::move(selection);
+        state_.want_extras  = extras;
+        state_.reading      = reading;
+        state_.sums.enabled = sums;
+
+        if (!index) {
+            src_    = openSource(filename, input, reading);
+            parser_ = createParser(&state_);
+            return;
+        }
+        size_t begin = static_cast<size_t>(index->offsets[start]);
+        src_ = prefetched(openRange(filename, begin, static_cast<size_t>(index->offsets[stop]) - begin, &input),
+                          reading, isRemote(filename));
+        state_.reweight           = index->reweight;
+        state_.init               = index->init;
+        state_.weight_ids         = index->weight_ids;
+        state_.n_declared_weights = static_cast<int>(index->weight_ids.size());
+        // the range is a sequence of <event> elements: give expat a root to put them in
+        static const char root[] = "<LesHouchesEvents>";
+        parser_ = createParser(&state_);
+        XML_Parse(parser_, root, sizeof(root) - 1, 0);
+        ranged_ = true;
+    }
+    ~LHEIterator() { XML_ParserFree(parser_); }
+
+    LHEIterator(const LHEIterator&) = delete;
+    LHEIterator& operator=(const LHEIterator&) = delete;
+
+    py::object next()
+    {
+        // the chunk is parsed without the GIL; the lock keeps concurrent calls on the same
+        // iterator apart (taken after releasing the GIL, which a waiting thread may need)
+        std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+        {
+            py::gil_scoped_release nogil;
+            lock.lock();
+        }
+        if (finished_) throw py::stop_iteration();
+
+        // two sets of buffers, so those of the previous chunk may still be in use while
+        // the next one is filled (a for loop only drops them after __next__ returns)
+        Slots& slots = slots_[n_chunks_ % 2];
+        {
+            py::gil_scoped_release nogil;
+            reclaimRows(slots.ievt, state_.ievt);
+            reclaimRows(slots.fevt, state_.fevt);
+            reclaimRows(slots.iptc, state_.iptc);
+            reclaimRows(slots.fptc, state_.fptc);
+            state_.cur_event    = 0;
+            state_.cur_particle = 0;
+            state_.n_events     = 0;      // first event of the chunk re-points the arrays
+            state_.n_particles  = 0;
+            state_.extras.clearRows();
+
+            fill();
+        }
+
+        if (n_chunks_ == 0 && !ranged_ && state_.fevt.buf.capacity == 0 && state_.n_rejected > 0)
+            setWeightColumns(&state_); // select= kept none
+        if (n_chunks_ == 0 && !ranged_
+            && (state_.cur_event + state_.n_rejected == 0 || state_.n_weights == 0
+                || (state_.cur_particle == 0 && !state_.selection)))
+            throw std::runtime_error("Found no events, weights, or particles.");
+        if (state_.cur_event == 0) throw py::stop_iteration();
+        ++n_chunks_;
+
+        py::object i_evt = lendRows(slots.ievt, state_.ievt, state_.cur_event);
+        py::object f_evt = lendRows(slots.fevt, state_.fevt, state_.cur_event);
+        py::object i_ptc = lendRows(slots.iptc, state_.iptc, state_.cur_particle);
+        py::object f_ptc = lendRows(slots.fptc, state_.fptc, state_.cur_particle);
+        if (arrow_) {
+            py::object events = py::cast(ArrowEvents(i_evt, f_evt, i_ptc, f_ptc, state_.cur_event));
+            if (!state_.want_extras) return events;
+            return py::make_tuple(events, state_.extras.toPython(state_.want_extras));
+        }
+        if (!state_.want_extras) return py::make_tuple(i_evt, f_evt, i_ptc, f_ptc);
+        return py::make_tuple(i_evt, f_evt, i_ptc, f_ptc, state_.extras.toPython(state_.want_extras));
+    }
+
+    // <initrwgt> contents, complete once the first chunk has been read
+    py::object reweight(bool table)
+    {
+        std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+        {
+            py::gil_scoped_release nogil;
+            lock.lock();
+        }
+        return state_.reweight.toPython(table);
+    }
+
+    // <init> as parse_lhe(init=True) returns it, once the first chunk has been read
+    py::object init()
+    {
+        std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+        {
+            py::gil_scoped_release nogil;
+            lock.lock();
+        }
+        if (!state_.init.found) return py::none();
+        return state_.init.toPython();
+    }
+
+    // sums=True: the weight sums over the chunks read so far, None without
+    py::object sums()
+    {
+        std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+        {
+            py::gil_scoped_release nogil;
+            lock.lock();
+        }
+        if (!state_.sums.enabled) return py::none();
+        return state_.sums.toPython();
+    }
+
+private:
+    struct Slots
+    {
+        SharedBuffer ievt, fevt, iptc, fptc;
+    };
+
+    // parse until onEnd suspends expat at a full chunk, or to the end of the input
+    void fill()
+    {
+        while (!finished_) {
+            XML_Status status;
+            if (suspended_) status = XML_ResumeParser(parser_);
+            else {
+                spillCapture(&state_); // expat may move its buffer for the next chunk
+                void* buf = XML_GetBuffer(parser_, static_cast<int>(state_.reading.chunk_size));
+                if (!buf) throw std::bad_alloc();
+                size_t got = src_->read(static_cast<char*>(buf), state_.reading.chunk_size);
+                final_ = got == 0;
+                if (final_ && ranged_) { // the root element is never closed
+                    finished_ = true;
+                    break;
+                }
+                status = XML_ParseBuffer(parser_, static_cast<int>(got), final_ ? 1 : 0);
+            }
+            if (status == XML_STATUS_ERROR) throw std::runtime_error(expatError(parser_));
+            suspended_ = status == XML_STATUS_SUSPENDED;
+            if (suspended_) return;
+            finished_ = final_;
+        }
+    }
+
+    ParseState                  state_;
+    std::unique_ptr<ByteSource> src_;
+    XML_Parser                  parser_    = nullptr;
+    Slots                       slots_[2];
+    std::mutex                  mutex_;
+    int                         n_chunks_  = 0;
+    bool                        suspended_ = false;
+    bool                        final_     = false;
+    bool                        finished_  = false;
+    bool                        ranged_    = false;
+    bool                        arrow_     = false;
+};
+
+std::unique_ptr<LHEIterator> iterLHE(const std::string& filename, int64_t chunk_events, const std::string& layout,
+                                     const std::string& index_dtype, const py::object& columns,
+                                     const py::object& weights, int64_t start, std::optional<int64_t> stop,
+                                     const std::string& select, bool extras, bool comments, bool compact,
+                                     const py::object& derived, int64_t chunk_size, const py::object& prefetch,
+                                     int64_t prefetch_size, bool sums)
+{
+    checkRange(start, stop);
+    ReadOptions reading = readOptions(chunk_size, prefetch, prefetch_size);
+    Projection projection = parseProjection(columns, weights, derived);
+    if (parseLayout(layout) == LAYOUT_ARROW) keepColumn(projection, "evt_idx");
+    std::shared_ptr<const Selection> selection;
+    if (!select.empty()) selection = std::make_shared<Selection>(select);
+    InputInfo input = probeInput(filename);
+    if (start == 0 && !stop)
+        return std::make_unique<LHEIterator>(filename, input, chunk_events, parseLayout(layout), parseIndexDtype(index_dtype), compact,
+                                             std::move(projection), std::move(selection), extrasKinds(extras, comments), reading, sums);
+
+    EventIndex index;
+    {
+        py::gil_scoped_release nogil;
+        findIndex(filename, input, true, index);
+    }
+    if (index.nEvents() == 0 || index.weight_ids.empty())
+        throw std::runtime_error("Found no events, weights, or particles.");
+    auto [first, last] = clipRange(start, stop, index.nEvents());
+    return std::make_unique<LHEIterator>(filename, input, chunk_events, parseLayout(layout), parseIndexDtype(index_dtype), compact,
+                                         std::move(projection), std::move(selection), extrasKinds(extras, comments), reading,
+                                         sums, &index, first, last);
+}
+
+// ---------------------------------------------------------------------------
+// Converted files – convert_lhe() parses a file once and stores the four arrays and the
+// <initrwgt> and <init> in a native binary file, which load_lhe() maps back: the arrays it returns
+// are numpy views of the mapping, so re-opening costs page faults instead of a parse
+//
+//   "QLHECOL2", header size, header: <initrwgt>, <init>, then per array its rows and columns
+//   (name, dtype, file offset); the columns of an array follow each other from a 64-byte
+//   aligned offset on, so the array maps as one Fortran-ordered 2-D array as well
+// ---------------------------------------------------------------------------
+static constexpr char   CONVERTED_MAGIC[8] = {'Q', 'L', 'H', 'E', 'C', 'O', 'L', '2'};
+static constexpr size_t CONVERTED_ALIGN    = 64;
+
+struct StoredColumn
+{
+    std::string name;
+    int         dtype  = DT_FLOAT64;
+    uint64_t    offset = 0;        // in the file
+    const char* data   = nullptr;  // convert_lhe(): the parsed column
+};
+
+struct StoredArray
+{
+    uint64_t rows = 0;
+    std::vector<StoredColumn> cols;
+};
+
+// the offsets are fixed-size, so the header has the same size before they are known
+static std::string convertedHeader(const ParsedFile& parsed, const std::vector<StoredArray>& arrays)
+{
+    IndexWriter w;
+    putReweight(w, parsed.reweight);
+    putInit(w, parsed.init);
+    w.put<uint64_t>(arrays.size());
+    for (const StoredArray& a : arrays) {
+        w.put(a.rows);
+        w.put<uint64_t>(a.cols.size());
+        for (const StoredColumn& c : a.cols) {
+            w.put(c.name);
+            w.put<int32_t>(c.dtype);
+            w.put(c.offset);
+        }
+    }
+    return std::move(w.out);
+}
+
+void convertLHE(const std::string& filename, const std::string& out_path, const std::string& format,
+                int n_threads, const std::string& engine, const std::string& index_dtype,
+                const py::object& columns, const py::object& weights, const std::string& select)
+{
+    if (format != "native")
+        throw std::invalid_argument("Unknown format '" + format + "', expected 'native'");
+
+    // layout='dict': every column is a contiguous 1-D array under its name
+    ParsedFile parsed = parseFile(filename, false, n_threads, engine, true, "dict", index_dtype, false,
+                                  columns, weights, py::none(), 0, std::nullopt, select, 0, false, ReadOptions(), nullptr, false);
+    std::vector<StoredArray> arrays;
+    for (const py::object& parsed_out : {parsed.i_evt, parsed.f_evt, parsed.i_ptc, parsed.f_ptc}) {
+        StoredArray a;
+        for (auto item : py::dict(parsed_out)) {
+            auto col = py::reinterpret_borrow<py::array>(item.second);
+            a.rows = static_cast<uint64_t>(col.shape(0));
+            a.cols.push_back({item.first.cast<std::string>(), dtypeCode(col.dtype()), 0,
+                              static_cast<const char*>(col.data())});
+        }
+        arrays.push_back(std::move(a));
+    }
+
+    uint64_t at = sizeof CONVERTED_MAGIC + sizeof(uint64_t) + convertedHeader(parsed, arrays).size();
+    for (StoredArray& a : arrays) {
+        at = (at + CONVERTED_ALIGN - 1) / CONVERTED_ALIGN * CONVERTED_ALIGN;
+        for (StoredColumn& c : a.cols) {
+            c.offset = at;
+            at += a.rows * dtypeSize(c.dtype);
+        }
+    }
+    std::string header = convertedHeader(parsed, arrays);
+    uint64_t header_size = header.size();
+
+    py::gil_scoped_release nogil;
+    static const char padding[CONVERTED_ALIGN] = {};
+    std::ofstream out(out_path, std::ios::binary | std::ios::trunc);
+    out.write(CONVERTED_MAGIC, sizeof CONVERTED_MAGIC);
+    out.write(reinterpret_cast<const char*>(&header_size), sizeof header_size);
+    out.write(header.data(), static_cast<std::streamsize>(header.size()));
+    uint64_t pos = sizeof CONVERTED_MAGIC + sizeof header_size + header.size();
+    for (const StoredArray& a : arrays)
+        for (const StoredColumn& c : a.cols) {
+            uint64_t bytes = a.rows * dtypeSize(c.dtype);
+            out.write(padding, static_cast<std::streamsize>(c.offset - pos));
+            out.write(c.data, static_cast<std::streamsize>(bytes));
+            pos = c.offset + bytes;
+        }
+    if (!out) throw std::runtime_error("Cannot write file: " + out_path);
+}
+
+// numpy arrays over the columns of `a`, stored in the mapping at `base`
+static py::object storedView(const StoredArray& a, char* base, int layout, py::handle owner)
+{
+    auto r = static_cast<py::ssize_t>(a.rows);
+    if (layout == LAYOUT_DICT) {
+        py::dict d;
+        for (const StoredColumn& c : a.cols) {
+            auto item = static_cast<py::ssize_t>(dtypeSize(c.dtype));
+            d[py::str(c.name)] = py::array(numpyDtype(c.dtype), {r}, {item}, base + c.offset, owner);
+        }
+        return d;
+    }
+
+    // a 2-D array needs one dtype and the columns back to back, as convert_lhe() stores them
+    int    dtype = a.cols.empty() ? DT_FLOAT64 : a.cols[0].dtype;
+    size_t width = a.cols.size(), item = dtypeSize(dtype);
+    char*  data  = a.cols.empty() ? base : base + a.cols[0].offset;
+    for (size_t c = 0; c < width; ++c)
+        if (a.cols[c].dtype != dtype || a.cols[c].offset != a.cols[0].offset + c * a.rows * item)
+            throw std::runtime_error("Stored columns cannot be loaded as one array, use layout='dict'");
+    auto i = static_cast<py::ssize_t>(item), w = static_cast<py::ssize_t>(width);
+    if (layout == LAYOUT_COLUMNAR) return py::array(numpyDtype(dtype), {r, w}, {i, i * r}, data, owner);
+
+    // layout='rows' is the one that is copied, the file is column-major
+    py::array rows(numpyDtype(dtype), {r, w});
+    char* dst = static_cast<char*>(rows.mutable_data());
+    for (size_t c = 0; c < width; ++c)
+        for (size_t k = 0; k < a.rows; ++k)
+            std::memcpy(dst + (k * width + c) * item, data + (c * a.rows + k) * item, item);
+    return rows;
+}
+
+py::tuple loadLHE(const std::string& filename, const std::string& layout_name, const std::string& reweight,
+                  bool init)
+{
+    int layout = parseLayout(layout_name);
+    bool table = parseReweightTable(reweight);
+    // copy-on-write pages: the arrays are writable like parsed ones, the file stays as it is
+    auto map = std::make_unique<MappedFile>(filename, true);
+    std::string_view data = map->view();
+    if (data.size() < sizeof CONVERTED_MAGIC || std::memcmp(data.data(), CONVERTED_MAGIC, sizeof CONVERTED_MAGIC - 1) != 0)
+        throw std::runtime_error("Not a converted LHE file: " + filename);
+    if (data[sizeof CONVERTED_MAGIC - 1] != CONVERTED_MAGIC[sizeof CONVERTED_MAGIC - 1])
+        throw std::runtime_error("Converted by an older version, convert it again: " + filename);
+
+    IndexReader r{data.substr(sizeof CONVERTED_MAGIC)};
+    uint64_t header_size = r.get<uint64_t>();
+    r.need(header_size);
+    r.in = r.in.substr(0, header_size);
+
+    ParsedFile loaded;
+    getReweight(r, loaded.reweight);
+    getInit(r, loaded.init);
+    std::vector<StoredArray> arrays(4);
+    if (r.get<uint64_t>() != arrays.size())
+        throw std::runtime_error("Corrupt converted file: " + filename);
+    for (StoredArray& a : arrays) {
+        a.rows = r.get<uint64_t>();
+        uint64_t n_cols = r.get<uint64_t>();
+        if (n_cols > r.in.size()) throw std::runtime_error("Corrupt converted file: " + filename);
+        a.cols.resize(n_cols);
+        for (StoredColumn& c : a.cols) {
+            c.name   = r.getString();
+            c.dtype  = r.get<int32_t>();
+            c.offset = r.get<uint64_t>();
+            if (c.dtype < DT_INT32 || c.dtype > DT_FLOAT64 || c.offset % dtypeSize(c.dtype) != 0
+                || c.offset > data.size() || a.rows > (data.size() - c.offset) / dtypeSize(c.dtype))
+                throw std::runtime_error("Corrupt converted file: " + filename);
+        }
+    }
+
+    char* base = map->data();
+    py::capsule owner(map.get(), [](void* p) { delete static_cast<MappedFile*>(p); });
+    map.release();
+    int view_layout = layout == LAYOUT_ARROW ? LAYOUT_DICT : layout;
+    loaded.i_evt = storedView(arrays[0], base, view_layout, owner);
+    loaded.f_evt = storedView(arrays[1], base, view_layout, owner);
+    loaded.i_ptc = storedView(arrays[2], base, view_layout, owner);
+    loaded.f_ptc = storedView(arrays[3], base, view_layout, owner);
+    if (layout != LAYOUT_ARROW) return loaded.toTuple(table, init);
+    py::list items;
+    items.append(loaded.reweight.toPython(table));
+    items.append(py::cast(ArrowEvents(loaded.i_evt, loaded.f_evt, loaded.i_ptc, loaded.f_ptc,
+                                          static_cast<int64_t>(arrays[0].rows))));
+    loaded.appendOptional(items, init);
+    return py::tuple(items);
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark – benchmark_lhe() times each phase of a parse on its own, over the input
+// decompressed into memory once, so the phases do not include each other's I/O
+// ---------------------------------------------------------------------------
+// best wall time of `repeat` runs of fn
+template <typename F>
+static double bestOf(int repeat, F fn)
+{
+    double best = std::numeric_limits<double>::infinity();
+    for (int r = 0; r < repeat; ++r) {
+        auto t0 = SteadyClock::now();
+        fn();
+        best = std::min(best, secondsSince(t0));
+    }
+    return best;
+}
+
+py::dict benchmarkLHE(const std::string& filename, int repeat, const std::string& layout_name)
+{
+    if (repeat < 1) throw std::invalid_argument("repeat must be positive");
+    int layout = parseLayout(layout_name);
+    InputInfo input = probeInput(filename);
+    int format = input.format;
+
+    std::string text;
+    Dimensions dims;
+    std::vector<std::string_view> events;
+    std::unique_ptr<ParseState> state;
+    double t_read, t_count, t_expat;
+    double t_events = std::numeric_limits<double>::infinity(), t_handoff = t_events;
+    {
+        py::gil_scoped_release nogil;
+        // read: I/O and decompression, into the text the next phases work on
+        t_read = bestOf(repeat, [&] {
+            auto src = openSource(filename, input);
+            text.clear();
+            for (std::string_view block = src->next(); !block.empty(); block = src->next()) text.append(block);
+        });
+        // count: pass 1, countDimensions()
+        t_count = bestOf(repeat, [&] { dims = countDimensions(std::string_view(text)); });
+        if (dims.n_events == 0 || dims.n_weights == 0 || dims.n_particles == 0)
+            throw std::runtime_error("Found no events, weights, or particles.");
+        // expat: XML tokenization alone, without callbacks
+        t_expat = bestOf(repeat, [&] {
+            XML_Parser parser = XML_ParserCreate(nullptr);
+            try { runParser(parser, text, true); } catch (...) { XML_ParserFree(parser); throw; }
+            XML_ParserFree(parser);
+        });
+
+        std::string_view sv = text;
+        for (size_t pos = findEventTag(sv); pos != std::string_view::npos; ) {
+            size_t end = sv.find("</event>", pos);
+            if (end == std::string_view::npos) break;
+            events.push_back(sv.substr(pos, end + 8 - pos));
+            pos = findEventTag(sv, end);
+        }
+    }
+
+    // events: processEvent() and the weights of every event, into growable rows as in
+    // single-pass mode; handoff: those rows passed to numpy and freed
+    for (int r = 0; r < repeat; ++r) {
+        {
+            py::gil_scoped_release nogil;
+            auto t0 = SteadyClock::now();
+            state = std::make_unique<ParseState>();
+            state->growable           = true;
+            configureOutputs(*state, layout, DT_INT32, false);
+            state->weight_ids         = dims.weight_ids;
+            state->n_declared_weights = dims.n_weights;
+            for (std::string_view ev : events)
+                if (!decodeEvent(state.get(), ev))
+                    throw std::runtime_error("benchmark_lhe: event " + std::to_string(state->cur_event)
+                                             + " needs expat (entities, comments or unknown tags)");
+            t_events = std::min(t_events, secondsSince(t0));
+        }
+        auto t0 = SteadyClock::now();
+        std::vector<py::object> outputs;
+        outputs.push_back(state->ievt.release(state->cur_event));
+        outputs.push_back(state->fevt.release(state->cur_event));
+        outputs.push_back(state->iptc.release(state->cur_particle));
+        outputs.push_back(state->fptc.release(state->cur_particle));
+        outputs.clear(); // the arrays are freed again within the phase
+        t_handoff = std::min(t_handoff, secondsSince(t0));
+    }
+
+    // total: parse_lhe() with its defaults, from the file
+    double t_total = bestOf(repeat, [&] {
+        parseFile(filename, false, 1, "expat", false, layout_name, "int32", false, py::none(), py::none(),
+                  py::none(), 0, std::nullopt, "", 0, false, ReadOptions(), nullptr, false);
+    });
+
+    auto n_events = static_cast<double>(state->cur_event);
+    auto mb       = static_cast<double>(text.size()) / 1e6;
+    py::dict phases;
+    for (auto [name, t] : {std::pair<const char*, double>{"read", t_read}, {"count", t_count}, {"expat", t_expat},
+                           {"events", t_events}, {"handoff", t_handoff}, {"total", t_total}}) {
+        py::dict phase;
+        phase["seconds"]      = t;
+        phase["mb_per_s"]     = t > 0 ? mb / t : 0.0;
+        phase["events_per_s"] = t > 0 ? n_events / t : 0.0;
+        phases[name] = phase;
+    }
+    static const char* const FORMAT_NAMES[] = {"plain", "gzip", "xz", "zstd"};
+    py::dict result;
+    result["file"]       = filename;
+    result["format"]     = FORMAT_NAMES[format];
+    result["file_bytes"] = input.size;
+    result["bytes"]      = text.size();
+    result["events"]     = state->cur_event;
+    result["particles"]  = state->cur_particle;
+    result["weights"]    = dims.n_weights;
+    result["repeat"]     = repeat;
+    result["phases"]     = phases;
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// pybind11 module
+// ---------------------------------------------------------------------------
+PYBIND11_MODULE(lhe_parser, m)
+{
+    m.doc() = "Fast LHE parser";
+    m.def("parse_lhe", &parseLHE, py::arg("filename"), py::arg("single_pass") = false,
+          py::arg("n_threads") = 1, py::arg("engine") = "expat", py::arg("mmap") = false,
+          py::arg("layout") = "rows", py::arg("index_dtype") = "int32",
+          py::arg("columns") = py::none(), py::arg("weights") = py::none(),
+          py::arg("start") = 0, py::arg("stop") = py::none(), py::arg("select") = "",
+          py::arg("reweight") = "dict", py::arg("extras") = false, py::arg("comments") = false,
+          py::arg("init") = false, py::arg("compact") = false, py::arg("derived") = py::none(),
+          py::arg("stats") = false, py::arg("chunk_size") = CHUNK, py::arg("prefetch") = py::none(),
+          py::arg("prefetch_size") = 4 * CHUNK, py::arg("out") = py::none(),
+          py::arg("sums") = false,
+          "Parse an LHE file or URL into (reweight, i_evt, f_evt, i_ptc, f_ptc); the options "
+          "are listed in README.md.");
+
+    m.def("parse_many", &parseMany, py::arg("filenames"), py::arg("n_threads") = 0,
+          py::arg("engine") = "expat", py::arg("mmap") = false, py::arg("layout") = "rows",
+          py::arg("index_dtype") = "int32", py::arg("columns") = py::none(), py::arg("weights") = py::none(),
+          py::arg("reweight") = "dict", py::arg("compact") = false, py::arg("derived") = py::none(),
+          "Parse several LHE files into one merged set of arrays: (reweight, i_evt, f_evt, i_ptc, "
+          "f_ptc, file_idx, init). The options are as for parse_lhe.");
+
+    py::class_<ArrowEvents>(m, "ArrowEvents")
+        .def("__arrow_c_array__", &ArrowEvents::exportArray, py::arg("requested_schema") = py::none())
+        .def("__len__", &ArrowEvents::size);
+    py::class_<LHEIterator>(m, "LHEIterator")
+        .def("__iter__", [](py::object self) { return self; })
+        .def("__next__", &LHEIterator::next)
+        .def_property_readonly("reweight", [](LHEIterator& it) { return it.reweight(false); })
+        .def_property_readonly("reweight_table", [](LHEIterator& it) { return it.reweight(true); })
+        .def_property_readonly("init", &LHEIterator::init)
+        .def_property_readonly("sums", &LHEIterator::sums);
+    m.def("iter_lhe", &iterLHE, py::arg("filename"), py::arg("chunk_events") = 100000,
+          py::arg("layout") = "rows", py::arg("index_dtype") = "int32",
+          py::arg("columns") = py::none(), py::arg("weights") = py::none(),
+          py::arg("start") = 0, py::arg("stop") = py::none(), py::arg("select") = "",
+          py::arg("extras") = false, py::arg("comments") = false, py::arg("compact") = false,
+          py::arg("derived") = py::none(), py::arg("chunk_size") = CHUNK, py::arg("prefetch") = py::none(),
+          py::arg("prefetch_size") = 4 * CHUNK, py::arg("sums") = false,
+          "Iterate over an LHE file, yielding the arrays of chunk_events events at a time. The "
+          "options are as for parse_lhe.");
+    m.def("build_index", &buildIndex, py::arg("filename"),
+          "Write an index of the events of filename, used by later parses while the file is "
+          "unchanged. Returns its path.");
+    m.def("convert_lhe", &convertLHE, py::arg("filename"), py::arg("out"), py::arg("format") = "native",
+          py::arg("n_threads") = 1, py::arg("engine") = "expat", py::arg("index_dtype") = "int32",
+          py::arg("columns") = py::none(), py::arg("weights") = py::none(), py::arg("select") = "",
+          "Parse an LHE file once and write the arrays to out, for load_lhe().");
+    m.def("benchmark_lhe", &benchmarkLHE, py::arg("filename"), py::arg("repeat") = 3, py::arg("layout") = "rows",
+          "Time the phases of a parse of filename separately, best of repeat runs each.");
+    m.def("load_lhe", &loadLHE, py::arg("filename"), py::arg("layout") = "columnar", py::arg("reweight") = "dict",
+          py::arg("init") = false,
+          "Map a file written by convert_lhe() and return the arrays as parse_lhe does.");
 }
\ No newline at end of file
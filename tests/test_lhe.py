@@ -0,0 +1,190 @@
+"""
+Tests of lhe_parser against the expat parse of small LHE files.
+
+   python3 -m pytest tests
+
+lhe_parser must be importable (build it next to this file, or put it on PYTHONPATH).
+tests/data/small.lhe has four events: one with <mgrwt>, one with <scales> and a '#' line,
+one the fast engine hands to expat (a comment after the particles) and one without particles.
+"""
+import os
+import shutil
+
+import numpy as np
+import pytest
+
+import lhe_parser
+
+SMALL = os.path.join(os.path.dirname(__file__), "data", "small.lhe")
+
+I_EVT = ["NUP", "IDPRUP"]
+F_EVT = ["XWGTUP", "SCALUP", "AQEDUP", "AQCDUP", "wgt_0", "wgt_1"]
+I_PTC = ["evt_idx", "IDUP", "ISTUP", "MOTHUP1", "MOTHUP2", "ICOLUP1", "ICOLUP2"]
+F_PTC = ["PUP1", "PUP2", "PUP3", "PUP4", "PUP5", "VTIMUP", "SPINUP"]
+
+HEADER = """<LesHouchesEvents version="3.0">
+<header>
+<initrwgt>
+<weight id="1"> muR=1 </weight>
+<weight id="2"> muR=2 </weight>
+</initrwgt>
+</header>
+<init>
+2212 2212 6.5e+03 6.5e+03 0 0 247000 247000 -4 1
+5.066e+02 1.3e+00 5.066e+02 1
+</init>
+"""
+
+
+def event(idup=21, mothup=0, weights=(1.0, 2.0)):
+    particle = f" {{}} -1 {mothup} 0 501 0 +0.0e+00 +0.0e+00 +4.0e+01 4.0e+01 0.0e+00 0.0e+00 9.0e+00\n"
+    return ("<event>\n 2 1 +5.0e+02 9.1e+01 7.5e-03 1.2e-01\n" + particle.format(idup) + particle.format(-idup)
+            + "<rwgt>\n" + "".join(f"<wgt id='{i + 1}'> {w:+.7e} </wgt>\n" for i, w in enumerate(weights))
+            + "</rwgt>\n</event>\n")
+
+
+def write(path, text):
+    with open(path, "w", newline="") as f:
+        f.write(text)
+    return str(path)
+
+
+@pytest.fixture(scope="module")
+def baseline():
+    return lhe_parser.parse_lhe(SMALL)
+
+
+def assert_same(result, baseline):
+    for got, want in zip(result[1:5], baseline[1:5]):
+        assert got.dtype == want.dtype
+        np.testing.assert_array_equal(got, want)
+
+
+def test_baseline(baseline):
+    reweight, i_evt, f_evt, i_ptc, f_ptc = baseline
+    assert i_evt.shape == (4, 2) and f_evt.shape == (4, 6)
+    assert i_ptc.shape == (9, 7) and f_ptc.shape == (9, 7)
+    assert list(i_evt[:, 0]) == [4, 3, 2, 0]
+    assert list(i_ptc[:, 0]) == [1, 1, 1, 1, 2, 2, 2, 3, 3]
+    assert f_evt[1, 5] == -6.1234e+02
+
+
+@pytest.mark.parametrize("engine", ["expat", "fast"])
+@pytest.mark.parametrize("n_threads", [1, 2])
+@pytest.mark.parametrize("mmap", [False, True])
+def test_engines(baseline, engine, n_threads, mmap):
+    assert_same(lhe_parser.parse_lhe(SMALL, engine=engine, n_threads=n_threads, mmap=mmap), baseline)
+
+
+@pytest.mark.parametrize("engine", ["expat", "fast"])
+def test_single_pass(baseline, engine):
+    assert_same(lhe_parser.parse_lhe(SMALL, single_pass=True, engine=engine), baseline)
+
+
+@pytest.mark.parametrize("engine", ["expat", "fast"])
+def test_columnar(baseline, engine):
+    result = lhe_parser.parse_lhe(SMALL, engine=engine, layout="columnar")
+    assert all(a.flags.f_contiguous for a in result[1:5])
+    assert_same(result, baseline)
+
+
+@pytest.mark.parametrize("engine", ["expat", "fast"])
+def test_dict(baseline, engine):
+    result = lhe_parser.parse_lhe(SMALL, engine=engine, layout="dict")
+    for d, names, want in zip(result[1:5], (I_EVT, F_EVT, I_PTC, F_PTC), baseline[1:5]):
+        assert list(d) == names
+        np.testing.assert_array_equal(np.column_stack([d[n] for n in names]), want)
+
+
+@pytest.mark.parametrize("engine", ["expat", "fast"])
+def test_arrow(baseline, engine):
+    pa = pytest.importorskip("pyarrow")
+    reweight, events = lhe_parser.parse_lhe(SMALL, engine=engine, layout="arrow")
+    array = pa.array(events)
+    assert len(events) == len(array) == 4  # the last event has no particles
+    np.testing.assert_array_equal(array.field("NUP").to_numpy(), baseline[1][:, 0])
+    particles = array.field("particles")
+    assert particles.offsets.to_pylist() == [0, 4, 7, 9, 9]
+    np.testing.assert_array_equal(particles.flatten().field("IDUP").to_numpy(), baseline[3][:, 1])
+
+
+@pytest.mark.parametrize("engine", ["expat", "fast"])
+def test_extras(engine):
+    want = lhe_parser.parse_lhe(SMALL, extras=True, comments=True)[-1]
+    got = lhe_parser.parse_lhe(SMALL, engine=engine, extras=True, comments=True)[-1]
+    for block in ("scales", "mgrwt"):
+        assert list(got[block]) == list(want[block])
+        for name in want[block]:
+            np.testing.assert_array_equal(got[block][name], want[block][name])
+    assert got["scales"]["muf"][1] == 120.0 and np.isnan(got["scales"]["muf"][0])
+
+
+@pytest.mark.parametrize("engine", ["expat", "fast"])
+def test_stats(engine):
+    result = lhe_parser.parse_lhe(SMALL, engine=engine, select="NUP > 0", stats=True)
+    stats = result[-1]
+    assert result[1].shape[0] == 3
+    assert (stats["events"], stats["rejected"], stats["particles"]) == (3, 1, 9)
+
+
+def test_crlf(tmp_path, baseline):
+    with open(SMALL) as f:
+        path = write(tmp_path / "crlf.lhe", f.read().replace("\n", "\r\n"))
+    for engine in ("expat", "fast"):
+        assert_same(lhe_parser.parse_lhe(path, engine=engine), baseline)
+
+
+def test_empty_range(tmp_path):
+    path = str(tmp_path / "small.lhe")
+    shutil.copy(SMALL, path)
+    for index in (False, True):
+        if index:
+            lhe_parser.build_index(path)
+        for n_threads in (1, 4):
+            result = lhe_parser.parse_lhe(path, start=2, stop=2, n_threads=n_threads)
+            assert result[1].shape == (0, 2) and result[3].shape == (0, 7)
+        result = lhe_parser.parse_lhe(path, start=1, stop=3, n_threads=4)
+        assert list(result[1][:, 0]) == [3, 2]
+
+
+@pytest.mark.parametrize("engine", ["expat", "fast"])
+def test_int32_out_of_range(tmp_path, engine):
+    path = write(tmp_path / "big.lhe", HEADER + event(idup=3000000000) + "</LesHouchesEvents>\n")
+    with pytest.raises(RuntimeError, match="int32"):
+        lhe_parser.parse_lhe(path, engine=engine)
+    i_ptc = lhe_parser.parse_lhe(path, engine=engine, index_dtype="int64")[3]
+    assert list(i_ptc[:, 1]) == [3000000000, -3000000000]
+
+
+@pytest.mark.parametrize("layout", ["dict", "arrow"])
+def test_compact_out_of_range(tmp_path, layout):
+    path = write(tmp_path / "mothers.lhe", HEADER + event() + event(mothup=40000) + "</LesHouchesEvents>\n")
+    with pytest.raises(RuntimeError, match="int16"):
+        lhe_parser.parse_lhe(path, layout=layout, compact=True)
+    i_ptc = lhe_parser.parse_lhe(path, layout="dict")[3]
+    assert list(i_ptc["MOTHUP1"]) == [0, 0, 40000, 40000]
+
+
+def test_mixed_weight_declarations(tmp_path):
+    # <weightinfo>s as well as <initrwgt>: the events carry <rwgt>, so the <initrwgt> declares
+    text = HEADER.replace("</init>\n", '<weightinfo name="a"/>\n<weightinfo name="b"/>\n'
+                                      '<weightinfo name="c"/>\n</init>\n')
+    path = write(tmp_path / "mixed.lhe", text + event(weights=(1.0, 2.0)) + "</LesHouchesEvents>\n")
+    for single_pass in (False, True):
+        f_evt = lhe_parser.parse_lhe(path, single_pass=single_pass)[2]
+        assert f_evt.shape == (1, 6)
+        assert list(f_evt[0, 4:]) == [1.0, 2.0]
+    lhe_parser.build_index(path)
+    assert lhe_parser.parse_lhe(path)[2].shape == (1, 6)
+
+
+def test_weightinfo(tmp_path):
+    text = HEADER.replace("<initrwgt>\n<weight id=\"1\"> muR=1 </weight>\n<weight id=\"2\"> muR=2 </weight>\n"
+                          "</initrwgt>\n", "")
+    text = text.replace("</init>\n", '<weightinfo name="a"/>\n<weightinfo name="b"/>\n</init>\n')
+    ev = event().replace("<rwgt>\n<wgt id='1'> +1.0000000e+00 </wgt>\n<wgt id='2'> +2.0000000e+00 </wgt>\n</rwgt>\n",
+                         "<weights> 3.0 4.0 </weights>\n")
+    path = write(tmp_path / "lhef2.lhe", text + ev + "</LesHouchesEvents>\n")
+    for engine in ("expat", "fast"):
+        f_evt = lhe_parser.parse_lhe(path, engine=engine)[2]
+        assert list(f_evt[0, 4:]) == [3.0, 4.0]